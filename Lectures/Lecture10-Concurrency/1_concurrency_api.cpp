@@ -87,7 +87,10 @@
 ////////////////////////////////////////////////////////////////////////////////
 /// Example
 ///
-/// - Parallel average of an array below
+/// - Parallel average of an array below, first split by hand into four
+///   tasks, then with a reusable reduction that picks the number of tasks,
+///   and last as a dataflow graph whose final division runs as soon as the
+///   four partial sums are ready, without a thread blocking on get
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <algorithm>
@@ -95,22 +98,25 @@
 #include <chrono>
 #include <future>
 #include <iostream>
+#include <numeric>
 #include <random>
 
+#include "../../Programming/Week10/parallel_reduce.h"
+#include "../../Programming/Week10/rng.h"
+#include "../../Programming/Week10/task_graph.h"
+
 ///////////////////////////////////////
 /// @brief Main driver
 /// @return Success/failure
 int
 main() {
-  // Generate array of random values
-  std::default_random_engine generator;
-  std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+  // Generate array of random values. The xoshiro256++ engine fills the whole
+  // array in bulk, far faster than a distribution on default_random_engine.
+  rng::xoshiro256pp generator;
 
   constexpr size_t SZ = 1'000'000;
   std::array<double, SZ> arr;
-  std::generate(arr.begin(), arr.end(),
-    [&distribution, &generator]() { return distribution(generator); }
-  );
+  generator.fill(arr.data(), SZ, -1.0, 1.0);
 
   using my_clock = std::chrono::high_resolution_clock;
   using seconds = std::chrono::duration<float>;
@@ -152,4 +158,43 @@ main() {
     my_clock::now() - start
   ).count();
   std::cout << "Time: " << time2 << "\tAverageP: " << avg2 << std::endl;
-}
\ No newline at end of file
+
+  // Same average with a generic reduction. It creates one task per hardware
+  // thread (for large enough arrays) and sums with Kahan compensation, so it
+  // scales past four cores and does not lose precision on long arrays.
+  start = my_clock::now();
+
+  double avg3 = 0;
+  for(size_t r = 0; r < 10000; ++r) // Repeating 10000 times is for dramatic effect
+    avg3 = parallel::parallel_reduce(
+      arr.begin(), arr.end(), 0., parallel::async_policy{0, summation::kahan}
+    )/SZ;
+
+  double time3 = std::chrono::duration_cast<seconds>(
+    my_clock::now() - start
+  ).count();
+  std::cout << "Time: " << time3 << "\tAverageR: " << avg3 << std::endl;
+
+  // Same four tasks as a dataflow graph on a pool. when_all joins the partial
+  // sums and then() divides them on the pool once the last one is done. Only
+  // the final get waits, all dependencies are handled by continuations.
+  start = my_clock::now();
+
+  thread_pool pool(4);
+  dataflow::graph g(pool);
+  auto part = [&](size_t _i, size_t _j) {
+    return g.spawn("sum", [&sum, _i, _j]() { return sum(_i, _j); });
+  };
+  auto avg = g.when_all("join", part(0, SZ/4), part(SZ/4, SZ/2),
+                        part(SZ/2, 3*SZ/4), part(3*SZ/4, SZ))
+    .then("average", [](const auto& _s) {
+      return (std::get<0>(_s) + std::get<1>(_s) + std::get<2>(_s) +
+              std::get<3>(_s))/SZ;
+    });
+  double avg4 = avg.get();
+
+  double time4 = std::chrono::duration_cast<seconds>(
+    my_clock::now() - start
+  ).count();
+  std::cout << "Time: " << time4 << "\tAverageD: " << avg4 << std::endl;
+}
@@ -7,6 +7,8 @@
 #include <iostream>
 #include <random>
 #include <vector>
+
+#include "../Week10/rng.h"
 using namespace std;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -18,9 +20,8 @@ main() {
   vector<double> vals(sz);
 
   // Random numbers
-  default_random_engine rng;
-  uniform_real_distribution<double> dist(0.0, 1.0);
-  generate_n(vals.begin(), sz, [&dist,&rng](){return dist(rng);});
+  rng::xoshiro256pp gen;
+  generate_n(vals.begin(), sz, [&gen](){return rng::to_unit(gen());});
 
   // Copy if x < 0.3 or x > 0.6
   vector<double> vals_if;
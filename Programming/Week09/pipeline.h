@@ -0,0 +1,378 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Lazy, fused pipelines of views and sinks.
+///
+/// A pipeline is written like a ranges pipeline,
+///
+///   auto v = pipeline::generate(n, g) | pipeline::filter(p)
+///          | pipeline::transform(f) | pipeline::sort(c);
+///
+/// but runs by pushing: a sink calls run() on the last view with a callback,
+/// every view wraps the callback of its successor, and the source calls the
+/// innermost one per element. The adaptors compose into a single loop over the
+/// source, without intermediate containers, and nothing happens until a sink
+/// is applied. Only sinks such as to_vector() or sort() materialize elements.
+///
+/// Every view knows an upper bound of its number of elements (exact for
+/// sources and transforms, the bound of the input for filters), which the
+/// materializing sinks reserve up front. A filtered bound can leave capacity
+/// unused, but memory that is never written is never touched, so this costs
+/// address space instead of reallocations and copies.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Lazy views and sinks
+////////////////////////////////////////////////////////////////////////////////
+namespace pipeline {
+
+constexpr size_t UNBOUNDED = SIZE_MAX; ///< Bound of views of unknown size
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Base of all views, marks a type as a view
+////////////////////////////////////////////////////////////////////////////////
+struct view_base {};
+
+/// @brief A pipeline view
+template<typename V>
+concept view = std::derived_from<std::remove_cvref_t<V>, view_base>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief View of the elements of a range
+/// @tparam R Range, a reference type for ranges that are not owned
+////////////////////////////////////////////////////////////////////////////////
+template<typename R>
+class source : public view_base {
+  public:
+    using value_type =
+      std::ranges::range_value_t<std::remove_reference_t<R>>; ///< Elements
+
+    /// @brief Construct
+    /// @param _r Range, referenced if an lvalue, else moved in
+    explicit source(R&& _r) : m_r(std::forward<R>(_r)) {}
+
+    /// @brief Number of elements if the range is sized
+    size_t bound() const {
+      if constexpr(std::ranges::sized_range<std::remove_reference_t<R>>)
+        return std::ranges::size(m_r);
+      else
+        return UNBOUNDED;
+    }
+
+    /// @brief Push every element
+    /// @param _s Callback
+    template<typename S>
+    void run(S&& _s) {
+      for(auto&& x : m_r)
+        _s(x);
+    }
+
+  private:
+    R m_r; ///< Range
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief View of the results of calling a generator n times
+/// @tparam G Generator, G()
+////////////////////////////////////////////////////////////////////////////////
+template<typename G>
+class generate_view : public view_base {
+  public:
+    using value_type =
+      std::remove_cvref_t<std::invoke_result_t<G&>>; ///< Elements
+
+    /// @brief Construct
+    /// @param _n Number of elements
+    /// @param _g Generator
+    generate_view(size_t _n, G _g) : m_n(_n), m_g(std::move(_g)) {}
+
+    /// @brief Number of elements
+    size_t bound() const { return m_n; }
+
+    /// @brief Push every element
+    /// @param _s Callback
+    template<typename S>
+    void run(S&& _s) {
+      for(size_t i = 0; i < m_n; ++i) {
+        value_type x = m_g();
+        _s(x);
+      }
+    }
+
+  private:
+    size_t m_n; ///< Number of elements
+    G m_g;      ///< Generator
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief View of the elements of a view satisfying a predicate
+/// @tparam V Input view
+/// @tparam P Predicate
+////////////////////////////////////////////////////////////////////////////////
+template<typename V, typename P>
+class filter_view : public view_base {
+  public:
+    using value_type = typename V::value_type; ///< Elements
+
+    /// @brief Construct
+    /// @param _v Input
+    /// @param _p Predicate
+    filter_view(V _v, P _p) : m_v(std::move(_v)), m_p(std::move(_p)) {}
+
+    /// @brief Bound of the input
+    size_t bound() const { return m_v.bound(); }
+
+    /// @brief Push every element passing the predicate
+    /// @param _s Callback
+    template<typename S>
+    void run(S&& _s) {
+      m_v.run([this, &_s](auto& _x) {
+        if(m_p(_x))
+          _s(_x);
+      });
+    }
+
+  private:
+    V m_v; ///< Input
+    P m_p; ///< Predicate
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief View of a function applied to the elements of a view
+/// @tparam V Input view
+/// @tparam F Function
+////////////////////////////////////////////////////////////////////////////////
+template<typename V, typename F>
+class transform_view : public view_base {
+  public:
+    using value_type = std::remove_cvref_t<
+      std::invoke_result_t<F&, typename V::value_type&>>; ///< Elements
+
+    /// @brief Construct
+    /// @param _v Input
+    /// @param _f Function
+    transform_view(V _v, F _f) : m_v(std::move(_v)), m_f(std::move(_f)) {}
+
+    /// @brief Number of elements of the input
+    size_t bound() const { return m_v.bound(); }
+
+    /// @brief Push the function of every element
+    /// @param _s Callback
+    template<typename S>
+    void run(S&& _s) {
+      m_v.run([this, &_s](auto& _x) {
+        value_type y = m_f(_x);
+        _s(y);
+      });
+    }
+
+  private:
+    V m_v; ///< Input
+    F m_f; ///< Function
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Turn a range into a view, views pass through
+/// @param _r View or range
+/// @return View
+template<typename R>
+auto
+all(R&& _r) {
+  if constexpr(view<R>)
+    return std::remove_cvref_t<R>(std::forward<R>(_r));
+  else
+    return source<R>(std::forward<R>(_r));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief View of the results of calling a generator
+/// @param _n Number of calls
+/// @param _g Generator, G()
+/// @return View
+template<typename G>
+generate_view<G>
+generate(size_t _n, G _g) {
+  return generate_view<G>(_n, std::move(_g));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Adaptors, applied with operator|
+/// @{
+
+/// @brief Filter adaptor
+template<typename P>
+struct filter_adaptor {
+  P p; ///< Predicate
+};
+
+/// @brief Transform adaptor
+template<typename F>
+struct transform_adaptor {
+  F f; ///< Function
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Keep the elements satisfying a predicate
+/// @param _p Predicate
+template<typename P>
+filter_adaptor<P>
+filter(P _p) {
+  return {std::move(_p)};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Apply a function to every element
+/// @param _f Function
+template<typename F>
+transform_adaptor<F>
+transform(F _f) {
+  return {std::move(_f)};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Apply a filter to a view or range
+template<typename R, typename P>
+auto
+operator|(R&& _r, filter_adaptor<P> _a) {
+  auto v = all(std::forward<R>(_r));
+  return filter_view<decltype(v), P>(std::move(v), std::move(_a.p));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Apply a transform to a view or range
+template<typename R, typename F>
+auto
+operator|(R&& _r, transform_adaptor<F> _a) {
+  auto v = all(std::forward<R>(_r));
+  return transform_view<decltype(v), F>(std::move(v), std::move(_a.f));
+}
+
+/// @}
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Sink, a function of a view applied with operator|
+/// @tparam F Function of the view
+////////////////////////////////////////////////////////////////////////////////
+template<typename F>
+struct sink {
+  F f; ///< Function of the view
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Run a view or range into a sink
+/// @param _r View or range
+/// @param _s Sink
+/// @return Result of the sink
+template<typename R, typename F>
+auto
+operator|(R&& _r, sink<F> _s) {
+  if constexpr(view<R>)
+    return _s.f(_r);
+  else {
+    auto v = all(std::forward<R>(_r));
+    return _s.f(v);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Sinks
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Collect into a vector, reserving the bound of the view
+inline auto
+to_vector() {
+  return sink{[](auto& _v) {
+    std::vector<typename std::remove_cvref_t<decltype(_v)>::value_type> out;
+    if(_v.bound() != UNBOUNDED)
+      out.reserve(_v.bound());
+    _v.run([&out](auto& _x) { out.push_back(_x); });
+    return out;
+  }};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Collect into a sorted vector
+/// @param _c Comparison
+template<typename C = std::less<>>
+auto
+sort(C _c = C()) {
+  return sink{[_c = std::move(_c)](auto& _v) {
+    auto out = to_vector().f(_v);
+    std::sort(out.begin(), out.end(), _c);
+    return out;
+  }};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Count the elements satisfying a predicate
+/// @param _p Predicate
+template<typename P>
+auto
+count_if(P _p) {
+  return sink{[_p = std::move(_p)](auto& _v) {
+    size_t n = 0;
+    _v.run([&n, &_p](auto& _x) { n += bool(_p(_x)); });
+    return n;
+  }};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Count the elements satisfying each of several predicates, in one
+///        pass
+/// @param _ps Predicates
+/// @return Sink returning an array of counts in the order of @c _ps
+template<typename... P>
+auto
+count_each(P... _ps) {
+  return sink{[... _ps = std::move(_ps)](auto& _v) {
+    std::array<size_t, sizeof...(P)> n{};
+    _v.run([&](auto& _x) {
+      size_t i = 0;
+      ((n[i++] += bool(_ps(_x))), ...);
+    });
+    return n;
+  }};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Fold the elements
+/// @param _init Initial value
+/// @param _op Operation, T(T, element)
+template<typename T, typename Op = std::plus<>>
+auto
+reduce(T _init, Op _op = Op()) {
+  return sink{[_init = std::move(_init), _op = std::move(_op)](auto& _v) {
+    T acc = _init;
+    _v.run([&acc, &_op](auto& _x) { acc = _op(std::move(acc), _x); });
+    return acc;
+  }};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Call a function on every element
+/// @param _f Function
+template<typename F>
+auto
+for_each(F _f) {
+  return sink{[_f = std::move(_f)](auto& _v) mutable {
+    _v.run(_f);
+  }};
+}
+
+/// @}
+////////////////////////////////////////////////////////////////////////////////
+
+}
@@ -0,0 +1,214 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief LSD radix sort of integral and floating point keys.
+///
+/// Keys are mapped to unsigned integers whose order is the order of the keys:
+/// unsigned keys as they are, signed keys with the sign bit flipped, and IEEE
+/// floating point keys with the sign bit flipped if positive and all bits
+/// flipped if negative. Descending order complements the mapped key. The
+/// sort then makes one pass per digit of Bits bits from the least significant
+/// one, each a stable counting scatter between the range and a buffer.
+///
+/// The histograms of all digits are counted in a single pass up front, which
+/// also finds the range of the keys. Digits that are the same for all keys are
+/// skipped, and if the range is small, e.g., values rounded to 0 or 1, a
+/// counting sort takes over. For plain arithmetic values it rebuilds the
+/// range from the counts without a buffer.
+///
+/// The sort is stable. Floating point keys are ordered by their bits, so -0
+/// goes before +0, and NaNs go after +inf or, if negative, before -inf.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Radix sorting
+////////////////////////////////////////////////////////////////////////////////
+namespace radix {
+
+/// @brief Order of a sort
+enum class order { ascending, descending };
+using enum order;
+
+/// @brief A key that can be radix sorted
+template<typename K>
+concept key = std::integral<K> ||
+  (std::floating_point<K> && std::numeric_limits<K>::is_iec559 &&
+   (sizeof(K) == 4 || sizeof(K) == 8));
+
+constexpr size_t SMALL_N = 256;         ///< Comparison sort below this size
+constexpr size_t COUNTING_MAX = 1 << 16; ///< Max key range of counting sort
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+/// @brief Unsigned integer of the size of a key
+template<typename K>
+using bits_t =
+  std::conditional_t<sizeof(K) == 1, uint8_t,
+  std::conditional_t<sizeof(K) == 2, uint16_t,
+  std::conditional_t<sizeof(K) == 4, uint32_t, uint64_t>>>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Map a key to an unsigned integer of the same order
+/// @param _k Key
+/// @param _o Order
+/// @return Mapped key
+template<key K>
+bits_t<K>
+to_bits(K _k, order _o) {
+  using U = bits_t<K>;
+  constexpr U sign = U(1) << (8*sizeof(U) - 1);
+  U u;
+  if constexpr(std::floating_point<K>) {
+    u = std::bit_cast<U>(_k);
+    u = (u & sign) ? U(~u) : U(u | sign);
+  }
+  else if constexpr(std::is_signed_v<K>)
+    u = U(_k) ^ sign;
+  else
+    u = U(_k);
+  return _o == descending ? U(~u) : u;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Map an unsigned integer back to its key
+/// @param _u Mapped key
+/// @param _o Order
+/// @return Key
+template<key K>
+K
+from_bits(bits_t<K> _u, order _o) {
+  using U = bits_t<K>;
+  constexpr U sign = U(1) << (8*sizeof(U) - 1);
+  U u = _o == descending ? U(~_u) : _u;
+  if constexpr(std::floating_point<K>)
+    return std::bit_cast<K>((u & sign) ? U(u ^ sign) : U(~u));
+  else if constexpr(std::is_signed_v<K>)
+    return K(u ^ sign);
+  else
+    return K(u);
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Sort a range by keys
+/// @tparam Bits Bits per digit
+/// @param _first Start of range
+/// @param _last End of range
+/// @param _key Key of an element, defaults to the element
+/// @param _o Order
+template<size_t Bits = 8, std::random_access_iterator It,
+         typename Key = std::identity>
+  requires key<std::remove_cvref_t<
+    std::invoke_result_t<Key&, std::iter_reference_t<It>>>>
+void
+sort(It _first, It _last, Key _key = {}, order _o = ascending) {
+  static_assert(Bits >= 1 && Bits <= 16, "1 to 16 bits per digit");
+  using T = std::iter_value_t<It>;
+  using K = std::remove_cvref_t<
+    std::invoke_result_t<Key&, std::iter_reference_t<It>>>;
+  using U = detail::bits_t<K>;
+  constexpr size_t D = (8*sizeof(U) + Bits - 1)/Bits; // Digits
+  constexpr size_t R = size_t(1) << Bits;              // Values of a digit
+  constexpr U MASK = U(R - 1);
+
+  auto bits = [&_key, _o](auto&& _x) {
+    return detail::to_bits<K>(std::invoke(_key, _x), _o);
+  };
+  size_t n = _last - _first;
+  if(n < SMALL_N) {
+    std::stable_sort(_first, _last, [&bits](auto& _a, auto& _b) {
+      return bits(_a) < bits(_b);
+    });
+    return;
+  }
+
+  // Histograms of all digits and range of the keys in one pass
+  std::vector<std::array<size_t, R>> hist(D);
+  U lo = std::numeric_limits<U>::max(), hi = 0;
+  for(It i = _first; i != _last; ++i) {
+    U u = bits(*i);
+    lo = std::min(lo, u);
+    hi = std::max(hi, u);
+    for(size_t d = 0; d < D; ++d)
+      ++hist[d][(u >> d*Bits) & MASK];
+  }
+
+  // Counting sort of small key ranges
+  if(size_t(hi - lo) < std::min(COUNTING_MAX, n)) {
+    std::vector<size_t> counts(size_t(hi - lo) + 1, 0);
+    for(It i = _first; i != _last; ++i)
+      ++counts[bits(*i) - lo];
+
+    if constexpr(std::same_as<Key, std::identity> && std::same_as<T, K>) {
+      It out = _first;
+      for(size_t v = 0; v < counts.size(); ++v)
+        out = std::fill_n(out, counts[v],
+                          detail::from_bits<K>(U(lo + v), _o));
+    }
+    else {
+      size_t sum = 0;
+      for(size_t& c : counts)
+        sum += std::exchange(c, sum);
+      std::vector<T> buf(n);
+      for(It i = _first; i != _last; ++i)
+        buf[counts[bits(*i) - lo]++] = std::move(*i);
+      std::move(buf.begin(), buf.end(), _first);
+    }
+    return;
+  }
+
+  // One stable scatter per digit, back and forth between range and buffer
+  std::vector<T> buf(n);
+  bool in_buf = false;
+  auto scatter = [&bits](auto _src, auto _end, auto _dst, size_t _shift,
+                         std::array<size_t, R>& _offsets) {
+    for(; _src != _end; ++_src)
+      _dst[_offsets[(bits(*_src) >> _shift) & MASK]++] = std::move(*_src);
+  };
+  for(size_t d = 0; d < D; ++d) {
+    std::array<size_t, R>& h = hist[d];
+    if(h[(lo >> d*Bits) & MASK] == n)
+      continue;
+    size_t sum = 0;
+    for(size_t& c : h)
+      sum += std::exchange(c, sum);
+    if(in_buf)
+      scatter(buf.begin(), buf.end(), _first, d*Bits, h);
+    else
+      scatter(_first, _last, buf.begin(), d*Bits, h);
+    in_buf = !in_buf;
+  }
+  if(in_buf)
+    std::move(buf.begin(), buf.end(), _first);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Sort a range of keys
+/// @tparam Bits Bits per digit
+/// @param _first Start of range
+/// @param _last End of range
+/// @param _o Order
+template<size_t Bits = 8, std::random_access_iterator It>
+void
+sort(It _first, It _last, order _o) {
+  sort<Bits>(_first, _last, std::identity{}, _o);
+}
+
+}
@@ -0,0 +1,726 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Branch-free SIMD copy_if (stream compaction) for comparisons of
+///        arithmetic values.
+///
+/// A scalar copy_if branches on every element, and on random data a branch
+/// like a < 0.3 || a > 0.6 mispredicts about every other time. The kernels
+/// here test a whole register of elements at once, which gives a bit mask of
+/// the survivors, and write the survivors packed to the output without any
+/// branch on the data:
+///
+/// - AVX-512 compresses the register by the mask (vcompress) and stores as
+///   many lanes as the mask has bits with a masked store.
+/// - AVX2 looks the mask up in a table of lane permutations that move the
+///   survivors to the front, permutes the register, and stores the first
+///   lanes with a masked store.
+///
+/// The kernels need to know the predicate, so it is written as an expression
+/// of the placeholder simd::arg instead of a lambda,
+///
+///   simd::copy_if(x.begin(), x.end(), y.begin(),
+///                 simd::arg < 0.3 || simd::arg > 0.6);
+///
+/// with the comparisons <, <=, >, >=, ==, != against constants, and &&, ||,
+/// and ! between them. Unlike the built-in operators, && and || evaluate both
+/// sides. The expressions are also plain callables, so everything the kernels
+/// do not cover, like other element types, non-contiguous iterators, or
+/// constants not exactly representable in the element type (compare floats to
+/// 0.3f, not 0.3), falls back to std::copy_if with the same predicate.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include "../Week10/cpu_isa.h"
+
+namespace simd {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Comparison of an element against a constant
+////////////////////////////////////////////////////////////////////////////////
+enum class relation {
+  lt, ///< x < c
+  le, ///< x <= c
+  gt, ///< x > c
+  ge, ///< x >= c
+  eq, ///< x == c
+  ne  ///< x != c
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Predicate comparing an element against a constant
+/// @tparam R Relation
+/// @tparam C Constant type
+////////////////////////////////////////////////////////////////////////////////
+template<relation R, typename C>
+struct comparison {
+  static constexpr relation rel = R; ///< Relation
+  C c;                               ///< Constant
+
+  /// @brief Test an element
+  template<typename T>
+  bool operator()(const T& _x) const {
+    if constexpr(R == relation::lt)      return _x < c;
+    else if constexpr(R == relation::le) return _x <= c;
+    else if constexpr(R == relation::gt) return _x > c;
+    else if constexpr(R == relation::ge) return _x >= c;
+    else if constexpr(R == relation::eq) return _x == c;
+    else                                 return _x != c;
+  }
+
+  /// @brief Whether comparing in the element type gives the same results
+  ///
+  /// Integers of mixed signedness compare after the usual arithmetic
+  /// conversions, e.g. -1 < 5u is false, which the element type cannot
+  /// reproduce, so these are never exact.
+  template<typename T>
+  bool exact() const {
+    if constexpr(std::integral<T> != std::integral<C>)
+      return false;
+    else if constexpr(std::integral<T> &&
+                      std::is_signed_v<T> != std::is_signed_v<C>)
+      return false;
+    else
+      return C(T(c)) == c;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Predicate true if both predicates are
+////////////////////////////////////////////////////////////////////////////////
+template<typename A, typename B>
+struct conjunction {
+  A a; ///< First predicate
+  B b; ///< Second predicate
+
+  /// @brief Test an element, without short circuit
+  template<typename T>
+  bool operator()(const T& _x) const { return bool(a(_x)) & bool(b(_x)); }
+
+  /// @brief Whether comparing in the element type gives the same results
+  template<typename T>
+  bool exact() const {
+    return a.template exact<T>() && b.template exact<T>();
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Predicate true if either predicate is
+////////////////////////////////////////////////////////////////////////////////
+template<typename A, typename B>
+struct disjunction {
+  A a; ///< First predicate
+  B b; ///< Second predicate
+
+  /// @brief Test an element, without short circuit
+  template<typename T>
+  bool operator()(const T& _x) const { return bool(a(_x)) | bool(b(_x)); }
+
+  /// @brief Whether comparing in the element type gives the same results
+  template<typename T>
+  bool exact() const {
+    return a.template exact<T>() && b.template exact<T>();
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Predicate true if a predicate is not
+////////////////////////////////////////////////////////////////////////////////
+template<typename A>
+struct negation {
+  A a; ///< Predicate
+
+  /// @brief Test an element
+  template<typename T>
+  bool operator()(const T& _x) const { return !a(_x); }
+
+  /// @brief Whether comparing in the element type gives the same results
+  template<typename T>
+  bool exact() const { return a.template exact<T>(); }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+/// @brief Whether a type is a predicate expression
+template<typename P>
+constexpr bool is_predicate = false;
+
+template<relation R, typename C>
+constexpr bool is_predicate<comparison<R, C>> = true;
+
+template<typename A, typename B>
+constexpr bool is_predicate<conjunction<A, B>> = true;
+
+template<typename A, typename B>
+constexpr bool is_predicate<disjunction<A, B>> = true;
+
+template<typename A>
+constexpr bool is_predicate<negation<A>> = true;
+
+/// @brief Whether a predicate expression is a conjunction
+template<typename P>
+constexpr bool is_conjunction = false;
+
+template<typename A, typename B>
+constexpr bool is_conjunction<conjunction<A, B>> = true;
+
+/// @brief Whether a predicate expression is a disjunction
+template<typename P>
+constexpr bool is_disjunction = false;
+
+template<typename A, typename B>
+constexpr bool is_disjunction<disjunction<A, B>> = true;
+
+/// @brief Whether a predicate expression is a negation
+template<typename P>
+constexpr bool is_negation = false;
+
+template<typename A>
+constexpr bool is_negation<negation<A>> = true;
+
+}
+
+/// @brief A predicate expression
+template<typename P>
+concept predicate = detail::is_predicate<std::remove_cvref_t<P>>;
+
+/// @brief A constant that can be compared against
+template<typename C>
+concept constant = std::is_arithmetic_v<C> && !std::same_as<C, bool>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Placeholder for the element in predicate expressions
+////////////////////////////////////////////////////////////////////////////////
+struct placeholder {};
+
+constexpr placeholder arg; ///< The element
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Predicate expressions
+/// @{
+
+template<constant C>
+constexpr comparison<relation::lt, C>
+operator<(placeholder, C _c) { return {_c}; }
+
+template<constant C>
+constexpr comparison<relation::le, C>
+operator<=(placeholder, C _c) { return {_c}; }
+
+template<constant C>
+constexpr comparison<relation::gt, C>
+operator>(placeholder, C _c) { return {_c}; }
+
+template<constant C>
+constexpr comparison<relation::ge, C>
+operator>=(placeholder, C _c) { return {_c}; }
+
+template<constant C>
+constexpr comparison<relation::eq, C>
+operator==(placeholder, C _c) { return {_c}; }
+
+template<constant C>
+constexpr comparison<relation::ne, C>
+operator!=(placeholder, C _c) { return {_c}; }
+
+template<constant C>
+constexpr comparison<relation::gt, C>
+operator<(C _c, placeholder) { return {_c}; }
+
+template<constant C>
+constexpr comparison<relation::ge, C>
+operator<=(C _c, placeholder) { return {_c}; }
+
+template<constant C>
+constexpr comparison<relation::lt, C>
+operator>(C _c, placeholder) { return {_c}; }
+
+template<constant C>
+constexpr comparison<relation::le, C>
+operator>=(C _c, placeholder) { return {_c}; }
+
+template<predicate A, predicate B>
+constexpr conjunction<A, B>
+operator&&(A _a, B _b) { return {_a, _b}; }
+
+template<predicate A, predicate B>
+constexpr disjunction<A, B>
+operator||(A _a, B _b) { return {_a, _b}; }
+
+template<predicate A>
+constexpr negation<A>
+operator!(A _a) { return {_a}; }
+
+/// @}
+////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+/// @brief Whether an element type has SIMD kernels
+template<typename T>
+constexpr bool has_simd_copy_if =
+  std::is_same_v<T, double> || std::is_same_v<T, float> ||
+  std::is_same_v<T, int32_t> || std::is_same_v<T, int64_t>;
+
+#ifdef CPU_ISA_X86
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Lane indices moving the lanes of a mask to the front, for 8 lanes
+///        of 32 bits, or for 4 lanes of 64 bits as pairs of 32-bit lanes
+/// @tparam L Lanes
+template<size_t L>
+constexpr auto
+make_permutations() {
+  std::array<std::array<uint8_t, 8>, size_t(1) << L> t{};
+  for(size_t m = 0; m < t.size(); ++m) {
+    size_t k = 0;
+    for(size_t l = 0; l < L; ++l)
+      if(m >> l & 1) {
+        for(size_t h = 0; h < 8/L; ++h)
+          t[m][k++] = uint8_t(l*8/L + h);
+      }
+  }
+  return t;
+}
+
+alignas(64) constexpr auto PERMUTATIONS_4 = make_permutations<4>();
+alignas(64) constexpr auto PERMUTATIONS_8 = make_permutations<8>();
+
+/// @brief All bits set in the first 8 - i 32-bit lanes, loaded from i
+alignas(64) constexpr int32_t PREFIX[16] = {
+  -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compare predicate of floating-point registers, NaN compares
+///        unequal to everything
+/// @tparam R Relation
+template<relation R>
+constexpr int
+cmp_fp() {
+  switch(R) {
+    case relation::lt: return _CMP_LT_OQ;
+    case relation::le: return _CMP_LE_OQ;
+    case relation::gt: return _CMP_GT_OQ;
+    case relation::ge: return _CMP_GE_OQ;
+    case relation::eq: return _CMP_EQ_OQ;
+    case relation::ne: return _CMP_NEQ_UQ;
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compare predicate of AVX-512 integer registers
+/// @tparam R Relation
+template<relation R>
+constexpr int
+cmp_int() {
+  switch(R) {
+    case relation::lt: return _MM_CMPINT_LT;
+    case relation::le: return _MM_CMPINT_LE;
+    case relation::gt: return _MM_CMPINT_NLE;
+    case relation::ge: return _MM_CMPINT_NLT;
+    case relation::eq: return _MM_CMPINT_EQ;
+    case relation::ne: return _MM_CMPINT_NE;
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief AVX2 operations on registers of elements
+/// @tparam T Element type
+////////////////////////////////////////////////////////////////////////////////
+template<typename T>
+struct avx2_ops;
+
+/// @brief AVX2 operations on doubles
+template<>
+struct avx2_ops<double> {
+  using reg = __m256d;       ///< Register
+  static constexpr size_t N = 4; ///< Lanes
+
+  __attribute__((target("avx2"), always_inline))
+  static inline reg load(const double* _x, size_t _n) {
+    return _n >= N ? _mm256_loadu_pd(_x) : _mm256_maskload_pd(_x,
+      _mm256_loadu_si256((const __m256i*)(PREFIX + 8 - 2*_n)));
+  }
+
+  template<relation R>
+  __attribute__((target("avx2"), always_inline))
+  static inline unsigned cmp(reg _x, double _c) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(_x, _mm256_set1_pd(_c),
+                                            cmp_fp<R>()));
+  }
+
+  __attribute__((target("avx2"), always_inline))
+  static inline void store(double* _y, unsigned _m, reg _x) {
+    __m256i p = _mm256_cvtepu8_epi32(
+      _mm_loadl_epi64((const __m128i*)PERMUTATIONS_4[_m].data()));
+    _mm256_maskstore_pd(_y,
+      _mm256_loadu_si256((const __m256i*)(PREFIX + 8 - 2*std::popcount(_m))),
+      _mm256_castps_pd(_mm256_permutevar8x32_ps(_mm256_castpd_ps(_x), p)));
+  }
+};
+
+/// @brief AVX2 operations on floats
+template<>
+struct avx2_ops<float> {
+  using reg = __m256;        ///< Register
+  static constexpr size_t N = 8; ///< Lanes
+
+  __attribute__((target("avx2"), always_inline))
+  static inline reg load(const float* _x, size_t _n) {
+    return _n >= N ? _mm256_loadu_ps(_x) : _mm256_maskload_ps(_x,
+      _mm256_loadu_si256((const __m256i*)(PREFIX + 8 - _n)));
+  }
+
+  template<relation R>
+  __attribute__((target("avx2"), always_inline))
+  static inline unsigned cmp(reg _x, float _c) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(_x, _mm256_set1_ps(_c),
+                                            cmp_fp<R>()));
+  }
+
+  __attribute__((target("avx2"), always_inline))
+  static inline void store(float* _y, unsigned _m, reg _x) {
+    __m256i p = _mm256_cvtepu8_epi32(
+      _mm_loadl_epi64((const __m128i*)PERMUTATIONS_8[_m].data()));
+    _mm256_maskstore_ps(_y,
+      _mm256_loadu_si256((const __m256i*)(PREFIX + 8 - std::popcount(_m))),
+      _mm256_permutevar8x32_ps(_x, p));
+  }
+};
+
+/// @brief AVX2 operations on 32-bit integers
+template<>
+struct avx2_ops<int32_t> {
+  using reg = __m256i;       ///< Register
+  static constexpr size_t N = 8; ///< Lanes
+
+  __attribute__((target("avx2"), always_inline))
+  static inline reg load(const int32_t* _x, size_t _n) {
+    return _n >= N ? _mm256_loadu_si256((const __m256i*)_x) :
+      _mm256_maskload_epi32(_x,
+        _mm256_loadu_si256((const __m256i*)(PREFIX + 8 - _n)));
+  }
+
+  template<relation R>
+  __attribute__((target("avx2"), always_inline))
+  static inline unsigned cmp(reg _x, int32_t _c) {
+    __m256i c = _mm256_set1_epi32(_c);
+    __m256i m;
+    if constexpr(R == relation::lt || R == relation::ge)
+      m = _mm256_cmpgt_epi32(c, _x);
+    else if constexpr(R == relation::gt || R == relation::le)
+      m = _mm256_cmpgt_epi32(_x, c);
+    else
+      m = _mm256_cmpeq_epi32(_x, c);
+    unsigned b = _mm256_movemask_ps(_mm256_castsi256_ps(m));
+    return R == relation::lt || R == relation::gt || R == relation::eq ?
+      b : ~b & 0xFF;
+  }
+
+  __attribute__((target("avx2"), always_inline))
+  static inline void store(int32_t* _y, unsigned _m, reg _x) {
+    __m256i p = _mm256_cvtepu8_epi32(
+      _mm_loadl_epi64((const __m128i*)PERMUTATIONS_8[_m].data()));
+    _mm256_maskstore_epi32(_y,
+      _mm256_loadu_si256((const __m256i*)(PREFIX + 8 - std::popcount(_m))),
+      _mm256_permutevar8x32_epi32(_x, p));
+  }
+};
+
+/// @brief AVX2 operations on 64-bit integers
+template<>
+struct avx2_ops<int64_t> {
+  using reg = __m256i;       ///< Register
+  static constexpr size_t N = 4; ///< Lanes
+
+  __attribute__((target("avx2"), always_inline))
+  static inline reg load(const int64_t* _x, size_t _n) {
+    return _n >= N ? _mm256_loadu_si256((const __m256i*)_x) :
+      _mm256_maskload_epi64((const long long*)_x,
+        _mm256_loadu_si256((const __m256i*)(PREFIX + 8 - 2*_n)));
+  }
+
+  template<relation R>
+  __attribute__((target("avx2"), always_inline))
+  static inline unsigned cmp(reg _x, int64_t _c) {
+    __m256i c = _mm256_set1_epi64x(_c);
+    __m256i m;
+    if constexpr(R == relation::lt || R == relation::ge)
+      m = _mm256_cmpgt_epi64(c, _x);
+    else if constexpr(R == relation::gt || R == relation::le)
+      m = _mm256_cmpgt_epi64(_x, c);
+    else
+      m = _mm256_cmpeq_epi64(_x, c);
+    unsigned b = _mm256_movemask_pd(_mm256_castsi256_pd(m));
+    return R == relation::lt || R == relation::gt || R == relation::eq ?
+      b : ~b & 0xF;
+  }
+
+  __attribute__((target("avx2"), always_inline))
+  static inline void store(int64_t* _y, unsigned _m, reg _x) {
+    __m256i p = _mm256_cvtepu8_epi32(
+      _mm_loadl_epi64((const __m128i*)PERMUTATIONS_4[_m].data()));
+    _mm256_maskstore_epi64((long long*)_y,
+      _mm256_loadu_si256((const __m256i*)(PREFIX + 8 - 2*std::popcount(_m))),
+      _mm256_permutevar8x32_epi32(_x, p));
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief AVX-512 operations on registers of elements
+/// @tparam T Element type
+////////////////////////////////////////////////////////////////////////////////
+template<typename T>
+struct avx512_ops;
+
+/// @brief AVX-512 operations on doubles
+template<>
+struct avx512_ops<double> {
+  using reg = __m512d;       ///< Register
+  static constexpr size_t N = 8; ///< Lanes
+
+  __attribute__((target("avx512f"), always_inline))
+  static inline reg load(const double* _x, unsigned _m) {
+    return _mm512_maskz_loadu_pd(__mmask8(_m), _x);
+  }
+
+  template<relation R>
+  __attribute__((target("avx512f"), always_inline))
+  static inline unsigned cmp(reg _x, double _c) {
+    return _mm512_cmp_pd_mask(_x, _mm512_set1_pd(_c), cmp_fp<R>());
+  }
+
+  __attribute__((target("avx512f"), always_inline))
+  static inline void store(double* _y, unsigned _m, reg _x) {
+    _mm512_mask_storeu_pd(_y, __mmask8((1u << std::popcount(_m)) - 1),
+                          _mm512_maskz_compress_pd(__mmask8(_m), _x));
+  }
+};
+
+/// @brief AVX-512 operations on floats
+template<>
+struct avx512_ops<float> {
+  using reg = __m512;        ///< Register
+  static constexpr size_t N = 16; ///< Lanes
+
+  __attribute__((target("avx512f"), always_inline))
+  static inline reg load(const float* _x, unsigned _m) {
+    return _mm512_maskz_loadu_ps(__mmask16(_m), _x);
+  }
+
+  template<relation R>
+  __attribute__((target("avx512f"), always_inline))
+  static inline unsigned cmp(reg _x, float _c) {
+    return _mm512_cmp_ps_mask(_x, _mm512_set1_ps(_c), cmp_fp<R>());
+  }
+
+  __attribute__((target("avx512f"), always_inline))
+  static inline void store(float* _y, unsigned _m, reg _x) {
+    _mm512_mask_storeu_ps(_y, __mmask16((1u << std::popcount(_m)) - 1),
+                          _mm512_maskz_compress_ps(__mmask16(_m), _x));
+  }
+};
+
+/// @brief AVX-512 operations on 32-bit integers
+template<>
+struct avx512_ops<int32_t> {
+  using reg = __m512i;       ///< Register
+  static constexpr size_t N = 16; ///< Lanes
+
+  __attribute__((target("avx512f"), always_inline))
+  static inline reg load(const int32_t* _x, unsigned _m) {
+    return _mm512_maskz_loadu_epi32(__mmask16(_m), _x);
+  }
+
+  template<relation R>
+  __attribute__((target("avx512f"), always_inline))
+  static inline unsigned cmp(reg _x, int32_t _c) {
+    return _mm512_cmp_epi32_mask(_x, _mm512_set1_epi32(_c), cmp_int<R>());
+  }
+
+  __attribute__((target("avx512f"), always_inline))
+  static inline void store(int32_t* _y, unsigned _m, reg _x) {
+    _mm512_mask_storeu_epi32(_y, __mmask16((1u << std::popcount(_m)) - 1),
+                             _mm512_maskz_compress_epi32(__mmask16(_m), _x));
+  }
+};
+
+/// @brief AVX-512 operations on 64-bit integers
+template<>
+struct avx512_ops<int64_t> {
+  using reg = __m512i;       ///< Register
+  static constexpr size_t N = 8; ///< Lanes
+
+  __attribute__((target("avx512f"), always_inline))
+  static inline reg load(const int64_t* _x, unsigned _m) {
+    return _mm512_maskz_loadu_epi64(__mmask8(_m), _x);
+  }
+
+  template<relation R>
+  __attribute__((target("avx512f"), always_inline))
+  static inline unsigned cmp(reg _x, int64_t _c) {
+    return _mm512_cmp_epi64_mask(_x, _mm512_set1_epi64(_c), cmp_int<R>());
+  }
+
+  __attribute__((target("avx512f"), always_inline))
+  static inline void store(int64_t* _y, unsigned _m, reg _x) {
+    _mm512_mask_storeu_epi64(_y, __mmask8((1u << std::popcount(_m)) - 1),
+                             _mm512_maskz_compress_epi64(__mmask8(_m), _x));
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Evaluate a predicate on an AVX2 register
+/// @tparam T Element type
+/// @param _p Predicate
+/// @param _x Elements
+/// @return Bit mask of the lanes satisfying @c _p
+template<typename T, typename P>
+__attribute__((target("avx2"), always_inline)) inline
+unsigned
+eval_avx2(const P& _p, typename avx2_ops<T>::reg _x) {
+  using O = avx2_ops<T>;
+  if constexpr(is_conjunction<P>)
+    return eval_avx2<T>(_p.a, _x) & eval_avx2<T>(_p.b, _x);
+  else if constexpr(is_disjunction<P>)
+    return eval_avx2<T>(_p.a, _x) | eval_avx2<T>(_p.b, _x);
+  else if constexpr(is_negation<P>)
+    return ~eval_avx2<T>(_p.a, _x) & ((1u << O::N) - 1);
+  else
+    return O::template cmp<P::rel>(_x, T(_p.c));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Evaluate a predicate on an AVX-512 register
+/// @tparam T Element type
+/// @param _p Predicate
+/// @param _x Elements
+/// @return Bit mask of the lanes satisfying @c _p
+template<typename T, typename P>
+__attribute__((target("avx512f"), always_inline)) inline
+unsigned
+eval_avx512(const P& _p, typename avx512_ops<T>::reg _x) {
+  using O = avx512_ops<T>;
+  if constexpr(is_conjunction<P>)
+    return eval_avx512<T>(_p.a, _x) & eval_avx512<T>(_p.b, _x);
+  else if constexpr(is_disjunction<P>)
+    return eval_avx512<T>(_p.a, _x) | eval_avx512<T>(_p.b, _x);
+  else if constexpr(is_negation<P>)
+    return ~eval_avx512<T>(_p.a, _x) & ((1u << O::N) - 1);
+  else
+    return O::template cmp<P::rel>(_x, T(_p.c));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief AVX2 copy_if
+/// @param _x Input
+/// @param _n Number of elements
+/// @param _y Output
+/// @param _p Predicate
+/// @return Number of elements copied
+template<typename T, typename P>
+__attribute__((target("avx2")))
+size_t
+copy_if_avx2(const T* _x, size_t _n, T* _y, const P& _p) {
+  using O = avx2_ops<T>;
+  size_t k = 0;
+  for(size_t i = 0; i < _n; i += O::N) {
+    size_t r = std::min(_n - i, O::N);
+    typename O::reg x = O::load(_x + i, r);
+    unsigned m = eval_avx2<T>(_p, x) & ((1u << r) - 1);
+    O::store(_y + k, m, x);
+    k += std::popcount(m);
+  }
+  return k;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief AVX-512 copy_if
+/// @param _x Input
+/// @param _n Number of elements
+/// @param _y Output
+/// @param _p Predicate
+/// @return Number of elements copied
+template<typename T, typename P>
+__attribute__((target("avx512f")))
+size_t
+copy_if_avx512(const T* _x, size_t _n, T* _y, const P& _p) {
+  using O = avx512_ops<T>;
+  size_t k = 0;
+  for(size_t i = 0; i < _n; i += O::N) {
+    unsigned valid = (1u << std::min(_n - i, O::N)) - 1;
+    typename O::reg x = O::load(_x + i, valid);
+    unsigned m = eval_avx512<T>(_p, x) & valid;
+    O::store(_y + k, m, x);
+    k += std::popcount(m);
+  }
+  return k;
+}
+
+#endif
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Copy the elements satisfying a predicate, with an instruction set
+/// @param _first First element
+/// @param _last One past the last element
+/// @param _d_first First output, must not overlap the input
+/// @param _p Predicate expression
+/// @param _i Instruction set, must be supported; the scalar fallback for
+///           the scalar and SSE2 instruction sets
+/// @return One past the last output
+template<std::input_iterator It, typename Out, predicate P>
+Out
+copy_if(It _first, It _last, Out _d_first, const P& _p, isa _i) {
+  if(!supported(_i))
+    throw std::invalid_argument("Unsupported instruction set.");
+  using T = std::iter_value_t<It>;
+  if constexpr(detail::has_simd_copy_if<T> && std::contiguous_iterator<It> &&
+               std::contiguous_iterator<Out>) {
+    if constexpr(std::is_same_v<std::iter_value_t<Out>, T>) {
+      if(_i >= isa::avx2 && _p.template exact<T>()) {
+        const T* x = std::to_address(_first);
+        T* y = std::to_address(_d_first);
+        size_t n = _last - _first;
+#ifdef CPU_ISA_X86
+        return _d_first + (_i == isa::avx512 ?
+          detail::copy_if_avx512(x, n, y, _p) :
+          detail::copy_if_avx2(x, n, y, _p));
+#endif
+      }
+    }
+  }
+  return std::copy_if(_first, _last, _d_first, _p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Copy the elements satisfying a predicate with the best kernel
+/// @param _first First element
+/// @param _last One past the last element
+/// @param _d_first First output, must not overlap the input
+/// @param _p Predicate expression
+/// @return One past the last output
+template<std::input_iterator It, typename Out, predicate P>
+Out
+copy_if(It _first, It _last, Out _d_first, const P& _p) {
+  return copy_if(_first, _last, _d_first, _p, best_isa());
+}
+
+}
@@ -0,0 +1,186 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Testing/timing of the fused pipelines against the staged chain of
+///        lambda_practice.cpp.
+///
+/// Bytes allocated are counted by replacing the global operator new. Bytes
+/// moved between memory and the caches are estimated as 64 bytes per
+/// last-level cache miss, where the performance counters are available.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "pipeline.h"
+
+#include "../Week10/benchmark.h"
+#include "../Week10/perf_counters.h"
+#include "../Week10/rng.h"
+#include "../Week10/test_check.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+
+constexpr size_t LINE_BYTES = 64; ///< Bytes per cache miss
+
+atomic<size_t> allocated{0};   ///< Bytes allocated through operator new
+atomic<size_t> allocations{0}; ///< Calls of operator new
+
+// GCC takes the free of a pointer from the replaced operator new for a
+// mismatch once both are inlined into library code
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Counting replacement of the global operator new
+void*
+operator new(size_t _n) {
+  allocated.fetch_add(_n, memory_order_relaxed);
+  allocations.fetch_add(1, memory_order_relaxed);
+  if(void* p = malloc(_n ? _n : 1))
+    return p;
+  throw bad_alloc();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Replacement of the global operator delete
+void
+operator delete(void* _p) noexcept {
+  free(_p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Replacement of the sized global operator delete
+void
+operator delete(void* _p, size_t) noexcept {
+  free(_p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Result of the chain, sorted values and the counts of 1s and 0s
+using result = pair<vector<int>, array<size_t, 2>>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Chain of lambda_practice.cpp, every stage materialized
+/// @param _n Number of random values
+/// @return Sorted values and counts
+result
+staged(size_t _n) {
+  vector<double> vals(_n);
+  rng::xoshiro256pp gen;
+  generate_n(vals.begin(), _n, [&gen](){return rng::to_unit(gen());});
+
+  vector<double> vals_if;
+  copy_if(vals.begin(), vals.end(), back_inserter(vals_if),
+    [](auto& a){return a < 0.3 || a > 0.6;}
+  );
+
+  vector<int> vals_i(vals_if.size());
+  transform(vals_if.begin(), vals_if.end(), vals_i.begin(),
+    [](auto& a){return (int)round(a);}
+  );
+
+  sort(vals_i.begin(), vals_i.end(),
+    [](auto& a, auto& b){return b < a;}
+  );
+
+  array<size_t, 2> counts{
+    size_t(count_if(vals_i.begin(), vals_i.end(),
+                    [](auto& a){return a == 1;})),
+    size_t(count_if(vals_i.begin(), vals_i.end(),
+                    [](auto& a){return a == 0;}))};
+  return {std::move(vals_i), counts};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Same chain as one fused pass into the sort, and one counting pass
+/// @param _n Number of random values
+/// @return Sorted values and counts
+result
+fused(size_t _n) {
+  rng::xoshiro256pp gen;
+  vector<int> vals_i =
+    pipeline::generate(_n, [&gen](){return rng::to_unit(gen());})
+    | pipeline::filter([](auto& a){return a < 0.3 || a > 0.6;})
+    | pipeline::transform([](auto& a){return (int)round(a);})
+    | pipeline::sort([](auto& a, auto& b){return b < a;});
+
+  array<size_t, 2> counts = vals_i | pipeline::count_each(
+    [](auto& a){return a == 1;}, [](auto& a){return a == 0;});
+  return {std::move(vals_i), counts};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Main driver
+/// @return Success/Failure
+int
+main() {
+  checks check;
+
+  // Views and sinks
+  {
+    vector<int> v{5, 1, 4, 2, 3};
+    auto sq = v | pipeline::filter([](int _x) { return _x%2; })
+                | pipeline::transform([](int _x) { return _x*_x; });
+    check("filter and transform",
+          (sq | pipeline::to_vector()) == vector<int>{25, 1, 9});
+    check("lazy, reruns see the source",
+          (v[0] = 7, (sq | pipeline::reduce(0))) == 59);
+    check("sort", (v | pipeline::sort()) == vector<int>{1, 2, 3, 4, 7});
+
+    list<double> l{0.5, 1.5, 2.5};
+    check("unsized source", (l | pipeline::transform([](double _x) {
+      return string(size_t(_x), 'x');
+    }) | pipeline::to_vector()) == vector<string>{"", "x", "xx"});
+
+    auto owned = vector<int>{1, 2, 3} | pipeline::transform([](int _x) {
+      return _x + 1;
+    });
+    check("owned source", (owned | pipeline::count_if([](int _x) {
+      return _x > 2;
+    })) == 2);
+
+    size_t n0 = allocations;
+    auto w = pipeline::generate(1000, []() { return 1.; })
+             | pipeline::filter([](double) { return true; })
+             | pipeline::to_vector();
+    check("output reserved once",
+          allocations - n0 == 1 && w.size() == 1000);
+  }
+
+  check("fused equals staged",
+        fused(1'000'003) == staged(1'000'003));
+
+  // Timing, allocations, and cache misses
+  cout << endl << fixed;
+  cout << setw(12) << "n" << setw(10) << "chain" << setw(12) << "time ms"
+       << setw(14) << "alloc MB" << setw(14) << "LLC-miss MB" << endl;
+  for(size_t n : {size_t(1'000'000), size_t(10'000'000)}) {
+    for(auto [name, f] : {pair{"staged", &staged}, pair{"fused", &fused}}) {
+      double t = bench::run("", [f, n]() { return f(n).second[0]; }).median;
+
+      size_t a0 = allocated;
+      perf::sample s = perf::measure({}, [f, n]() {
+        bench::do_not_optimize(f(n).second[0]);
+      });
+      double alloc = double(allocated - a0);
+
+      cout << setw(12) << n << setw(10) << name << setprecision(2)
+           << setw(12) << t*1e3 << setw(14) << alloc/1e6 << setw(14);
+      if(s.has(perf::event::llc_misses))
+        cout << s[perf::event::llc_misses]*LINE_BYTES/1e6;
+      else
+        cout << "n/a";
+      cout << endl;
+    }
+  }
+
+  return check.status();
+}
@@ -0,0 +1,179 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Testing/timing of the radix sort against std::sort.
+///
+/// Times include copying the unsorted input, which is the same for all sorts.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "radix_sort.h"
+
+#include "../Week10/benchmark.h"
+#include "../Week10/rng.h"
+#include "../Week10/test_check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Record sorted by a key, with its original position
+////////////////////////////////////////////////////////////////////////////////
+struct record {
+  double key{0}; ///< Key
+  size_t pos{0}; ///< Original position
+
+  bool operator==(const record&) const = default;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Random values
+/// @tparam T Value type
+/// @param _n Number of values
+/// @param _f Function of a random 64 bit integer
+/// @return Values
+template<typename T, typename F>
+vector<T>
+random(size_t _n, F _f) {
+  rng::xoshiro256pp gen;
+  vector<T> v(_n);
+  for(T& x : v)
+    x = _f(gen());
+  return v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Radix sort in both orders and compare against std::sort
+/// @tparam Bits Bits per digit
+/// @param _v Values
+/// @return Same results
+template<size_t Bits = 8, typename T>
+bool
+matches_std(vector<T> _v) {
+  vector<T> a = _v, d = _v;
+  radix::sort<Bits>(a.begin(), a.end());
+  radix::sort<Bits>(d.begin(), d.end(), radix::descending);
+  vector<T> sa = _v, sd = _v;
+  sort(sa.begin(), sa.end());
+  sort(sd.begin(), sd.end(), greater<>());
+  return a == sa && d == sd;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Main driver
+/// @return Success/Failure
+int
+main() {
+  checks check;
+  const size_t n = 100'003;
+
+  check("int", matches_std(random<int>(n, [](uint64_t _r) {
+    return int(_r);
+  })));
+  check("int, 11 bit digits", matches_std<11>(random<int>(n,
+    [](uint64_t _r) { return int(_r); })));
+  check("uint64_t", matches_std(random<uint64_t>(n, [](uint64_t _r) {
+    return _r;
+  })));
+  check("int64_t, 16 bit digits", matches_std<16>(random<int64_t>(n,
+    [](uint64_t _r) { return int64_t(_r); })));
+  check("int8_t, counting", matches_std(random<int8_t>(n,
+    [](uint64_t _r) { return int8_t(_r); })));
+  check("small n", matches_std(random<int>(100, [](uint64_t _r) {
+    return int(_r%10) - 5;
+  })));
+
+  auto dbl = random<double>(n, [](uint64_t _r) {
+    return ldexp(rng::to_unit(_r) - 0.5, int(_r%64) - 32);
+  });
+  dbl[0] = numeric_limits<double>::infinity();
+  dbl[1] = -numeric_limits<double>::infinity();
+  dbl[2] = numeric_limits<double>::denorm_min();
+  dbl[3] = -numeric_limits<double>::denorm_min();
+  dbl[4] = numeric_limits<double>::max();
+  dbl[5] = numeric_limits<double>::lowest();
+  check("double", matches_std(dbl));
+  check("float", matches_std(random<float>(n, [](uint64_t _r) {
+    return float(rng::to_unit(_r) - 0.5)*1e4f;
+  })));
+
+  {
+    vector<double> z{0., -0., 1., -1., 0., -0.};
+    z.resize(1000, 0.5);
+    vector<double> zc = z;
+    radix::sort(zc.begin(), zc.end());
+    check("-0 before +0", signbit(zc[1]) && signbit(zc[2]) &&
+                          !signbit(zc[3]) && !signbit(zc[4]));
+  }
+
+  // Key extraction, stable in both orders, for spread and small key ranges
+  for(double scale : {1e6, 1.}) {
+    auto r = random<record>(n, [scale](uint64_t _r) {
+      return record{round(rng::to_unit(_r)*scale), 0};
+    });
+    for(size_t i = 0; i < r.size(); ++i)
+      r[i].pos = i;
+    bool stable = true;
+    for(radix::order o : {radix::ascending, radix::descending}) {
+      vector<record> a = r, s = r;
+      radix::sort(a.begin(), a.end(), &record::key, o);
+      stable_sort(s.begin(), s.end(),
+        [o](const record& _a, const record& _b) {
+          return o == radix::ascending ? _a.key < _b.key : _b.key < _a.key;
+        });
+      stable &= a == s;
+    }
+    check("key extraction, stable, range " + to_string(int(scale)),
+          stable);
+  }
+
+  // Timing
+  bench::options opt;
+  opt.min_samples = 3;
+  auto time = [&opt](auto _v, auto _sort) {
+    return bench::run("", [&_v, &_sort]() {
+      auto w = _v;
+      _sort(w);
+      return w[w.size()/2];
+    }, opt).median*1e3;
+  };
+  auto row = [&time](const string& _name, size_t _n, auto _v,
+                     radix::order _o) {
+    auto std_sort = [_o](auto& _w) {
+      if(_o == radix::ascending)
+        sort(_w.begin(), _w.end());
+      else
+        sort(_w.begin(), _w.end(), greater<>());
+    };
+    cout << setw(16) << _name << setw(12) << _n
+         << setw(12) << time(_v, std_sort)
+         << setw(12) << time(_v, [_o](auto& _w) {
+              radix::sort<8>(_w.begin(), _w.end(), _o); })
+         << setw(12) << time(_v, [_o](auto& _w) {
+              radix::sort<11>(_w.begin(), _w.end(), _o); })
+         << endl;
+  };
+
+  cout << endl << fixed << setprecision(1);
+  cout << setw(16) << "keys" << setw(12) << "n" << setw(12) << "std ms"
+       << setw(12) << "radix8 ms" << setw(12) << "radix11 ms" << endl;
+  for(size_t m : {size_t(1'000'000), size_t(10'000'000)}) {
+    auto u = [](uint64_t _r) { return rng::to_unit(_r); };
+    row("int desc", m, random<int>(m, [](uint64_t _r) { return int(_r); }),
+        radix::descending);
+    row("int 0/1 desc", m,
+        random<int>(m, [&u](uint64_t _r) { return int(round(u(_r))); }),
+        radix::descending);
+    row("uint64_t", m, random<uint64_t>(m, [](uint64_t _r) { return _r; }),
+        radix::ascending);
+    row("double", m, random<double>(m, u), radix::ascending);
+  }
+
+  return check.status();
+}
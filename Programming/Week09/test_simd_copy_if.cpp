@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Testing/timing of the SIMD copy_if against std::copy_if.
+////////////////////////////////////////////////////////////////////////////////
+
+// Comparing ints against an unsigned constant below is deliberate
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#include "simd_copy_if.h"
+
+#include "../Week10/benchmark.h"
+#include "../Week10/rng.h"
+#include "../Week10/test_check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <numeric>
+#include <string>
+#include <vector>
+using namespace std;
+
+using simd::arg;
+
+constexpr size_t N = 1 << 20; ///< Elements of the timed inputs
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Random values
+/// @tparam T Value type
+/// @param _n Number of values
+/// @param _f Function of a random 64 bit integer
+/// @return Values
+template<typename T, typename F>
+vector<T>
+random(size_t _n, F _f) {
+  rng::xoshiro256pp gen;
+  vector<T> v(_n);
+  for(T& x : v)
+    x = _f(gen());
+  return v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compare against std::copy_if for every supported instruction set
+///        and several prefixes of the input
+/// @param _x Input
+/// @param _p Predicate expression
+/// @return Same outputs, NaNs included, and nothing written past them
+template<typename T, typename P>
+bool
+matches_std(const vector<T>& _x, const P& _p) {
+  const T guard = T(-7);
+  auto same = [](T _a, T _b) { return _a == _b || (_a != _a && _b != _b); };
+  bool ok = true;
+  for(simd::isa i : {simd::isa::scalar, simd::isa::avx2, simd::isa::avx512}) {
+    if(!simd::supported(i))
+      continue;
+    for(size_t n : {size_t(0), size_t(1), size_t(5), size_t(17), size_t(63),
+                    _x.size()}) {
+      vector<T> want;
+      std::copy_if(_x.begin(), _x.begin() + n, back_inserter(want), _p);
+      vector<T> got(want.size() + 1, guard);
+      auto e = simd::copy_if(_x.begin(), _x.begin() + n, got.begin(), _p, i);
+      ok &= e == got.begin() + want.size() &&
+            equal(want.begin(), want.end(), got.begin(), same) &&
+            got.back() == guard;
+    }
+  }
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Main driver
+/// @return Success/Failure
+int
+main() {
+  checks check;
+  cout << "best isa " << simd::name(simd::best_isa()) << endl;
+
+  auto unit = [](uint64_t _r) { return rng::to_unit(_r); };
+  auto dbl = random<double>(1001, unit);
+  dbl[3] = numeric_limits<double>::quiet_NaN();
+  dbl[4] = 0.3;
+  check("double, lambda_practice filter",
+        matches_std(dbl, arg < 0.3 || arg > 0.6));
+  check("double, all relations",
+        matches_std(dbl, arg <= 0.3 || arg >= 0.6) &&
+        matches_std(dbl, (arg == 0.3) || (arg != 0.3 && arg > 0.9)));
+  check("double, negation and constant on the left",
+        matches_std(dbl, !(0.3 <= arg && 0.6 >= arg)));
+
+  auto flt = random<float>(1001, unit);
+  check("float", matches_std(flt, arg < 0.3f || arg > 0.6f));
+  check("float, inexact constant falls back",
+        matches_std(flt, arg < 0.3 || arg > 0.6));
+
+  auto i32 = random<int32_t>(1001, [](uint64_t _r) {
+    return int32_t(_r%200) - 100;
+  });
+  check("int32_t", matches_std(i32, arg < -50 || arg >= 50) &&
+                   matches_std(i32, arg <= 0 && arg != -3) &&
+                   matches_std(i32, !(arg == 7) && arg > 5));
+
+  // Negatives convert to large unsigned values, so only 0..4 are below 5u
+  {
+    vector<int> v(64);
+    iota(v.begin(), v.end(), -32);
+    check("int, unsigned constant falls back",
+          matches_std(v, arg < 5u) && matches_std(v, arg >= 5u));
+  }
+
+  auto i64 = random<int64_t>(1001, [](uint64_t _r) {
+    return int64_t(_r);
+  });
+  check("int64_t", matches_std(i64, arg < int64_t(-1) << 62 ||
+                                    arg >= int64_t(1) << 62) &&
+                   matches_std(i64, arg <= 0 && arg != 0));
+
+  {
+    list<double> l(dbl.begin(), dbl.end());
+    vector<double> want, got;
+    std::copy_if(dbl.begin(), dbl.end(), back_inserter(want), arg < 0.5);
+    simd::copy_if(l.begin(), l.end(), back_inserter(got), arg < 0.5);
+    check("iterators fall back", want == got);
+  }
+
+  // Timing, ns per element of the lambda_practice filter
+  auto x = random<double>(N, unit);
+  vector<double> y(N);
+  auto time = [&x, &y](auto _f) {
+    return bench::run("", [&]() { return _f() - y.begin(); }).median*1e9/N;
+  };
+
+  cout << endl << fixed << setprecision(2);
+  cout << setw(28) << "kernel" << setw(12) << "ns/elem" << endl;
+  cout << setw(28) << "std::copy_if, lambda" << setw(12) << time([&]() {
+    return std::copy_if(x.begin(), x.end(), y.begin(),
+                        [](auto& a){return a < 0.3 || a > 0.6;});
+  }) << endl;
+  for(simd::isa i : {simd::isa::scalar, simd::isa::avx2, simd::isa::avx512})
+    if(simd::supported(i))
+      cout << setw(28) << simd::name(i) << setw(12) << time([&]() {
+        return simd::copy_if(x.begin(), x.end(), y.begin(),
+                             arg < 0.3 || arg > 0.6, i);
+      }) << endl;
+
+  return check.status();
+}
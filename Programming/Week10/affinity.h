@@ -0,0 +1,301 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief CPU topology discovery and thread placement on Linux.
+///
+/// The topology is read from sysfs, restricted to the CPUs the process may run
+/// on. A placement turns it into one CPU per worker, and workers pin
+/// themselves with sched_setaffinity before touching any per-worker state, so
+/// Linux's first-touch policy allocates that state on the worker's NUMA node.
+/// On other systems, or without sysfs, every CPU is its own core on node 0 and
+/// pinning is a no-op.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Choice of where workers run
+////////////////////////////////////////////////////////////////////////////////
+enum class placement {
+  none,    ///< Leave placement to the scheduler
+  compact, ///< Fill all hardware threads of a core, then the next core
+  scatter, ///< Spread over nodes and cores first, SMT siblings last
+  physical ///< One worker per physical core, wrapping if there are more
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief CPU topology and pinning
+////////////////////////////////////////////////////////////////////////////////
+namespace affinity {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief One logical CPU (hardware thread)
+////////////////////////////////////////////////////////////////////////////////
+struct cpu {
+  int id{0};      ///< OS CPU number
+  int package{0}; ///< Socket
+  int core{0};    ///< Dense physical core index over all packages
+  int smt{0};     ///< Rank among the hardware threads of its core
+  int node{0};    ///< NUMA node
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Logical CPUs available to the process
+////////////////////////////////////////////////////////////////////////////////
+struct topology {
+  std::vector<cpu> cpus; ///< Sorted by id
+
+  /// @brief Number of physical cores
+  size_t num_cores() const { return count(&cpu::core); }
+  /// @brief Number of packages
+  size_t num_packages() const { return count(&cpu::package); }
+  /// @brief Number of NUMA nodes
+  size_t num_nodes() const { return count(&cpu::node); }
+
+  private:
+    /// @brief Number of distinct values of a field
+    size_t count(int cpu::* _field) const {
+      std::set<int> s;
+      for(const cpu& c : cpus)
+        s.insert(c.*_field);
+      return s.size();
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read one integer from a sysfs file
+/// @param _path File
+/// @param _default Value if the file cannot be read
+inline int
+read_int(const std::string& _path, int _default) {
+  std::ifstream ifs(_path);
+  int v;
+  return ifs >> v ? v : _default;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parse a sysfs CPU list such as "0-3,8,10-11"
+/// @param _list List
+/// @return CPU numbers
+inline std::vector<int>
+parse_list(const std::string& _list) {
+  std::vector<int> ids;
+  std::istringstream iss(_list);
+  std::string range;
+  while(std::getline(iss, range, ',')) {
+    int a, b;
+    if(std::sscanf(range.c_str(), "%d-%d", &a, &b) == 2)
+      for(int i = a; i <= b; ++i)
+        ids.push_back(i);
+    else if(std::sscanf(range.c_str(), "%d", &a) == 1)
+      ids.push_back(a);
+  }
+  return ids;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Discover the topology of the CPUs the process may run on
+/// @return Topology, never empty
+inline topology
+detect() {
+  namespace fs = std::filesystem;
+  const std::string sys = "/sys/devices/system/";
+
+  std::vector<int> ids;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if(sched_getaffinity(0, sizeof(set), &set) == 0)
+    for(int i = 0; i < CPU_SETSIZE; ++i)
+      if(CPU_ISSET(i, &set))
+        ids.push_back(i);
+#endif
+  if(ids.empty())
+    for(unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency());
+        ++i)
+      ids.push_back(int(i));
+
+  // NUMA node of each CPU, from the node directories
+  std::map<int, int> node_of;
+  std::error_code ec;
+  for(const fs::directory_entry& d :
+      fs::directory_iterator(sys + "node", ec)) {
+    std::string name = d.path().filename().string();
+    if(name.rfind("node", 0) != 0 || name.size() == 4 ||
+       !std::all_of(name.begin() + 4, name.end(), ::isdigit))
+      continue;
+    std::ifstream ifs(d.path() / "cpulist");
+    std::string list;
+    std::getline(ifs, list);
+    for(int c : detail::parse_list(list))
+      node_of[c] = std::stoi(name.substr(4));
+  }
+
+  topology t;
+  std::map<std::pair<int, int>, int> cores; // (package, core_id) -> dense
+  std::map<int, int> threads;               // dense core -> threads seen
+  for(int id : ids) {
+    std::string dir = sys + "cpu/cpu" + std::to_string(id) + "/topology/";
+    cpu c;
+    c.id = id;
+    c.package = detail::read_int(dir + "physical_package_id", 0);
+    int core_id = detail::read_int(dir + "core_id", id);
+    auto it = cores.emplace(std::make_pair(c.package, core_id),
+                            int(cores.size())).first;
+    c.core = it->second;
+    c.smt = threads[c.core]++;
+    c.node = node_of.count(id) ? node_of[id] : 0;
+    t.cpus.push_back(c);
+  }
+  return t;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief CPU of every worker for a placement
+/// @param _t Topology
+/// @param _p Placement
+/// @param _nt Number of workers
+/// @return One CPU number per worker, -1 for no pinning
+///
+/// Workers beyond the chosen CPUs wrap around, so oversubscription is spread
+/// evenly instead of piling onto the last CPU.
+inline std::vector<int>
+plan(const topology& _t, placement _p, size_t _nt) {
+  if(_p == placement::none || _t.cpus.empty())
+    return std::vector<int>(_nt, -1);
+
+  // Rank of every core within its package, for round robin over packages
+  std::map<int, int> core_rank;
+  std::map<int, int> seen;
+  for(const cpu& c : _t.cpus)
+    if(!core_rank.count(c.core))
+      core_rank[c.core] = seen[c.package]++;
+
+  std::vector<cpu> order = _t.cpus;
+  if(_p == placement::compact)
+    std::sort(order.begin(), order.end(), [](const cpu& _a, const cpu& _b) {
+      return std::tie(_a.node, _a.package, _a.core, _a.smt, _a.id)
+           < std::tie(_b.node, _b.package, _b.core, _b.smt, _b.id);
+    });
+  else {
+    std::sort(order.begin(), order.end(),
+              [&core_rank](const cpu& _a, const cpu& _b) {
+      int ra = core_rank[_a.core], rb = core_rank[_b.core];
+      return std::tie(_a.smt, ra, _a.node, _a.package, _a.id)
+           < std::tie(_b.smt, rb, _b.node, _b.package, _b.id);
+    });
+    if(_p == placement::physical)
+      order.erase(std::remove_if(order.begin(), order.end(),
+                                 [](const cpu& _c) { return _c.smt > 0; }),
+                  order.end());
+  }
+
+  std::vector<int> cpus(_nt);
+  for(size_t i = 0; i < _nt; ++i)
+    cpus[i] = order[i % order.size()].id;
+  return cpus;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Pin the calling thread to one CPU
+/// @param _cpu CPU number, negative to leave the thread unpinned
+/// @return True if the thread is pinned
+inline bool
+pin(int _cpu) {
+#ifdef __linux__
+  if(_cpu < 0 || _cpu >= CPU_SETSIZE)
+    return false;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(_cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  (void)_cpu;
+  return false;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief CPU the calling thread is running on, -1 if unknown
+inline int
+current_cpu() {
+#ifdef __linux__
+  return sched_getcpu();
+#else
+  return -1;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Kernel thread id of the calling thread, 0 if unknown
+inline int
+thread_id() {
+#ifdef __linux__
+  return int(syscall(SYS_gettid));
+#else
+  return 0;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Name of a placement
+inline const char*
+name(placement _p) {
+  switch(_p) {
+    case placement::compact:  return "compact";
+    case placement::scatter:  return "scatter";
+    case placement::physical: return "physical";
+    default:                  return "none";
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parse a placement name
+/// @param _s Name as returned by name()
+/// @return Placement, empty for unknown names
+inline std::optional<placement>
+parse(const std::string& _s) {
+  for(placement p : {placement::none, placement::compact, placement::scatter,
+                     placement::physical})
+    if(_s == name(p))
+      return p;
+  return std::nullopt;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief One line summary of a topology
+inline std::string
+describe(const topology& _t) {
+  std::ostringstream oss;
+  oss << _t.cpus.size() << " cpus, " << _t.num_cores() << " physical cores, "
+      << _t.num_packages() << " packages, " << _t.num_nodes() << " NUMA nodes";
+  return oss.str();
+}
+
+}
@@ -0,0 +1,240 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Anytime monte carlo approximation of pi with early termination.
+///
+/// Instead of fixing the number of samples up front, samples are drawn block by
+/// block (see sequential::count_block) until the confidence interval is tight
+/// enough, a deadline passes, or a sample budget is used up. The running
+/// estimate is published after every block.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "parallel_pi.h"
+#include "sequential_pi.h"
+#include "thread_pool.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Running estimate of pi
+////////////////////////////////////////////////////////////////////////////////
+struct pi_estimate {
+  size_t n{0};       ///< Samples drawn
+  size_t n_inner{0}; ///< Samples inside the circle
+
+  /// @brief Estimate of pi
+  double value() const { return n == 0 ? 0. : 4.*n_inner/n; }
+
+  /// @brief Standard error of value(), from the binomial variance
+  double std_error() const {
+    if(n == 0)
+      return INFINITY;
+    double p = double(n_inner)/n;
+    return 4.*std::sqrt(p*(1. - p)/n);
+  }
+
+  /// @brief Half-width of the confidence interval
+  /// @param _z Critical value, e.g., 1.96 for 95%
+  double half_width(double _z) const { return _z*std_error(); }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief When to stop an anytime estimation
+////////////////////////////////////////////////////////////////////////////////
+struct stop_rule {
+  double tolerance{1e-3};  ///< Target half-width of the confidence interval
+  double z{1.96};          ///< Critical value of the confidence interval
+  std::chrono::steady_clock::duration budget{std::chrono::seconds(1)};
+                           ///< Wall-clock budget
+  size_t max_n{size_t(1) << 40}; ///< Sample budget
+  size_t min_n{sequential::BLOCK_SIZE}; ///< Samples before trusting the error
+
+  /// @brief Check whether an estimate satisfies the rule
+  /// @param _e Estimate
+  /// @param _deadline Time the budget runs out
+  bool done(const pi_estimate& _e,
+            std::chrono::steady_clock::time_point _deadline) const {
+    return _e.n >= max_n
+        || std::chrono::steady_clock::now() >= _deadline
+        || (_e.n >= min_n && _e.half_width(z) <= tolerance);
+  }
+};
+
+namespace sequential {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi until a stop rule is met
+/// @tparam F Callback type
+/// @param _rule Stop rule
+/// @param _on_update Called with the running estimate after every block
+/// @param _seed Seed
+/// @return Final estimate
+template<typename F>
+pi_estimate
+anytime_pi(const stop_rule& _rule, F&& _on_update, uint64_t _seed = 0) {
+  auto deadline = std::chrono::steady_clock::now() + _rule.budget;
+  pi_estimate e;
+  for(size_t b = 0; b < num_blocks(_rule.max_n) && !_rule.done(e, deadline);
+      ++b) {
+    e.n_inner += count_block(_rule.max_n, b, _seed);
+    e.n = std::min(_rule.max_n, (b + 1)*BLOCK_SIZE);
+    _on_update(e);
+  }
+  return e;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi until a stop rule is met
+/// @param _rule Stop rule
+/// @param _seed Seed
+/// @return Final estimate
+inline pi_estimate
+anytime_pi(const stop_rule& _rule, uint64_t _seed = 0) {
+  return anytime_pi(_rule, [](const pi_estimate&) {}, _seed);
+}
+
+}
+
+namespace parallel {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Partial counts of one worker, on its own cache line.
+///
+/// Only the owning worker writes, so a sequence lock (odd while writing) lets
+/// the coordinator read a consistent pair without locks or RMW contention.
+////////////////////////////////////////////////////////////////////////////////
+struct alignas(64) partial_count {
+  std::atomic<size_t> seq{0};     ///< Sequence number, odd during a write
+  std::atomic<size_t> n{0};       ///< Samples drawn
+  std::atomic<size_t> n_inner{0}; ///< Samples inside the circle
+
+  /// @brief Add a finished block, called by the owner only
+  void add(size_t _n, size_t _n_inner) {
+    seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    n.store(n.load(std::memory_order_relaxed) + _n, std::memory_order_relaxed);
+    n_inner.store(n_inner.load(std::memory_order_relaxed) + _n_inner,
+                  std::memory_order_relaxed);
+    seq.fetch_add(1, std::memory_order_release);
+  }
+
+  /// @brief Consistent snapshot, called by any thread
+  pi_estimate read() const {
+    while(true) {
+      size_t s0 = seq.load(std::memory_order_acquire);
+      pi_estimate e{n.load(std::memory_order_relaxed),
+                    n_inner.load(std::memory_order_relaxed)};
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if(s0 % 2 == 0 && seq.load(std::memory_order_relaxed) == s0)
+        return e;
+    }
+  }
+};
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi until a stop rule is met
+/// @tparam F Callback type
+/// @param _rule Stop rule
+/// @param _nt Number of workers, at least 1
+/// @param _pool Pool executing the workers
+/// @param _on_update Called from the calling thread with the running estimate
+/// @param _poll Interval between merges of the workers' partial counts
+/// @param _seed Seed
+/// @return Final estimate, including every block finished before stopping
+///
+/// Workers claim blocks from a shared counter and publish their counts in
+/// per-worker slots; the calling thread merges the slots, reports, and raises
+/// a stop flag that workers check between blocks. Throws std::invalid_argument
+/// without workers, which would never make progress.
+template<typename F>
+pi_estimate
+anytime_pi(const stop_rule& _rule, size_t _nt, thread_pool& _pool,
+           F&& _on_update,
+           std::chrono::steady_clock::duration _poll =
+             std::chrono::milliseconds(1),
+           uint64_t _seed = 0) {
+  if(_nt == 0)
+    throw std::invalid_argument("Anytime pi requires at least one worker.");
+  auto deadline = std::chrono::steady_clock::now() + _rule.budget;
+  const size_t nb = sequential::num_blocks(_rule.max_n);
+  std::atomic<size_t> next{0};
+  std::atomic<bool> stop{false};
+
+  // Every worker allocates its own slot, so a pinned worker first-touches it
+  // on its NUMA node, and publishes it for the merges once it exists
+  std::vector<std::unique_ptr<detail::partial_count>> owned(_nt);
+  std::vector<std::atomic<detail::partial_count*>> partials(_nt);
+
+  auto worker = [&](size_t _i) {
+    owned[_i] = std::make_unique<detail::partial_count>();
+    detail::partial_count& mine = *owned[_i];
+    partials[_i].store(&mine, std::memory_order_release);
+    for(size_t b = next++; b < nb && !stop.load(std::memory_order_relaxed);
+        b = next++) {
+      size_t n = std::min(_rule.max_n, (b + 1)*sequential::BLOCK_SIZE)
+               - b*sequential::BLOCK_SIZE;
+      mine.add(n, sequential::count_block(_rule.max_n, b, _seed));
+    }
+  };
+
+  std::vector<std::future<void>> fts;
+  fts.reserve(_nt);
+  for(size_t i = 0; i < _nt; ++i)
+    fts.emplace_back(_pool.submit(worker, i));
+
+  auto merge = [&partials]() {
+    pi_estimate e;
+    for(auto& p : partials) {
+      const detail::partial_count* pc = p.load(std::memory_order_acquire);
+      if(!pc)
+        continue;
+      pi_estimate pe = pc->read();
+      e.n += pe.n;
+      e.n_inner += pe.n_inner;
+    }
+    return e;
+  };
+
+  pi_estimate e = merge();
+  while(!_rule.done(e, deadline)) {
+    std::this_thread::sleep_for(_poll);
+    e = merge();
+    _on_update(e);
+  }
+  stop = true;
+
+  for(auto& ft : fts)
+    ft.get();
+  return merge();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi until a stop rule is met
+/// @param _rule Stop rule
+/// @param _nt Number of workers, at least 1
+/// @param _pool Pool executing the workers
+/// @param _seed Seed
+/// @return Final estimate
+inline pi_estimate
+anytime_pi(const stop_rule& _rule, size_t _nt, thread_pool& _pool,
+           uint64_t _seed = 0) {
+  return anytime_pi(_rule, _nt, _pool, [](const pi_estimate&) {},
+                    std::chrono::milliseconds(1), _seed);
+}
+
+}
@@ -0,0 +1,376 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Coroutine-based asynchronous approximation of pi with cancellation.
+///
+/// async_pi is an asynchronous generator: every co_await of next() counts one
+/// chunk of blocks (see sequential::count_block) on an executor and yields the
+/// running estimate. While a chunk runs, no thread waits for it: the coroutine
+/// is suspended and the executor task finishing the chunk last resumes it. A
+/// stop token is checked between chunks. The final estimate of an uncancelled
+/// run equals sequential::reproducible_pi.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <optional>
+#include <stop_token>
+#include <utility>
+
+#include "anytime_pi.h"
+#include "sequential_pi.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Minimal coroutine types
+////////////////////////////////////////////////////////////////////////////////
+namespace coro {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Anything tasks can be submitted to, e.g., thread_pool
+template<typename E>
+concept executor = requires(E& _e, void (*_f)()) { _e.submit(_f); };
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Executor running tasks immediately on the submitting thread
+////////////////////////////////////////////////////////////////////////////////
+struct inline_executor {
+  /// @brief Run a task
+  template<typename F>
+  void submit(F&& _f) { _f(); }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Lazily started coroutine producing one value
+/// @tparam T Value type
+///
+/// Starts when awaited and resumes its awaiter when done.
+////////////////////////////////////////////////////////////////////////////////
+template<typename T>
+class task {
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Coroutine promise
+    ////////////////////////////////////////////////////////////////////////////
+    struct promise_type {
+      std::optional<T> value;             ///< Result
+      std::exception_ptr error;           ///< Exception thrown by the body
+      std::coroutine_handle<> awaiter;    ///< Resumed at the end
+
+      /// @brief Resume the awaiter when done
+      struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<promise_type> _h) noexcept {
+          std::coroutine_handle<> a = _h.promise().awaiter;
+          return a ? a : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+      };
+
+      task get_return_object() {
+        return task(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+      std::suspend_always initial_suspend() noexcept { return {}; }
+      final_awaiter final_suspend() noexcept { return {}; }
+      template<typename U>
+      void return_value(U&& _v) { value.emplace(std::forward<U>(_v)); }
+      void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors and special member functions
+    /// @{
+
+    /// @brief Move constructor
+    task(task&& _t) noexcept : m_h(std::exchange(_t.m_h, nullptr)) {}
+    /// @brief Destructor
+    ~task() {
+      if(m_h)
+        m_h.destroy();
+    }
+    /// @brief Copy constructor
+    task(const task&) = delete;
+    /// @brief Copy assignment
+    task& operator=(const task&) = delete;
+    /// @brief Move assignment
+    task& operator=(task&&) = delete;
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Start the task and wait for its value
+    auto operator co_await() && noexcept {
+      struct awaitable {
+        std::coroutine_handle<promise_type> h;
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<> _awaiter) noexcept {
+          h.promise().awaiter = _awaiter;
+          return h;
+        }
+        T await_resume() {
+          if(h.promise().error)
+            std::rethrow_exception(h.promise().error);
+          return std::move(*h.promise().value);
+        }
+      };
+      return awaitable{m_h};
+    }
+
+  private:
+    /// @brief Construct from the coroutine
+    explicit task(std::coroutine_handle<promise_type> _h) : m_h(_h) {}
+
+    std::coroutine_handle<promise_type> m_h; ///< Coroutine
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Asynchronous generator, a stream of values produced by a coroutine
+///        that may suspend on other awaitables between values
+/// @tparam T Value type
+////////////////////////////////////////////////////////////////////////////////
+template<typename T>
+class async_generator {
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Coroutine promise
+    ////////////////////////////////////////////////////////////////////////////
+    struct promise_type {
+      const T* current{nullptr};       ///< Value of the last co_yield
+      std::exception_ptr error;        ///< Exception thrown by the body
+      std::coroutine_handle<> awaiter; ///< Consumer awaiting next()
+
+      /// @brief Hand control back to the consumer
+      struct yield_awaiter {
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<promise_type> _h) noexcept {
+          return _h.promise().awaiter;
+        }
+        void await_resume() noexcept {}
+      };
+
+      async_generator get_return_object() {
+        return async_generator(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+      std::suspend_always initial_suspend() noexcept { return {}; }
+      yield_awaiter final_suspend() noexcept { return {}; }
+      yield_awaiter yield_value(const T& _v) noexcept {
+        current = &_v;
+        return {};
+      }
+      void return_void() noexcept {}
+      void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors and special member functions
+    /// @{
+
+    /// @brief Move constructor
+    async_generator(async_generator&& _g) noexcept :
+      m_h(std::exchange(_g.m_h, nullptr)) {}
+    /// @brief Destructor, only valid while not awaiting next()
+    ~async_generator() {
+      if(m_h)
+        m_h.destroy();
+    }
+    /// @brief Copy constructor
+    async_generator(const async_generator&) = delete;
+    /// @brief Copy assignment
+    async_generator& operator=(const async_generator&) = delete;
+    /// @brief Move assignment
+    async_generator& operator=(async_generator&&) = delete;
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Resume the producer until its next value
+    /// @return Awaitable of the value, empty once the producer is done
+    auto next() noexcept {
+      struct awaitable {
+        std::coroutine_handle<promise_type> h;
+        bool await_ready() noexcept { return h.done(); }
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<> _awaiter) noexcept {
+          h.promise().awaiter = _awaiter;
+          h.promise().current = nullptr;
+          return h;
+        }
+        std::optional<T> await_resume() {
+          if(h.promise().error)
+            std::rethrow_exception(std::exchange(h.promise().error, nullptr));
+          if(h.done() || !h.promise().current)
+            return std::nullopt;
+          return *h.promise().current;
+        }
+      };
+      return awaitable{m_h};
+    }
+
+  private:
+    /// @brief Construct from the coroutine
+    explicit async_generator(std::coroutine_handle<promise_type> _h) :
+      m_h(_h) {}
+
+    std::coroutine_handle<promise_type> m_h; ///< Coroutine
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Eagerly started coroutine nobody waits for
+////////////////////////////////////////////////////////////////////////////////
+struct detached {
+  /// @brief Coroutine promise
+  struct promise_type {
+    detached get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Run a task and deliver its value to a promise
+template<typename T>
+inline detached
+run(task<T> _t, std::promise<T> _p) {
+  try {
+    _p.set_value(co_await std::move(_t));
+  }
+  catch(...) {
+    _p.set_exception(std::current_exception());
+  }
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Start a task from non-coroutine code
+/// @tparam T Value type
+/// @param _t Task
+/// @return Future of the value of the task
+template<typename T>
+inline std::future<T>
+spawn(task<T> _t) {
+  std::promise<T> p;
+  std::future<T> ft = p.get_future();
+  detail::run(std::move(_t), std::move(p));
+  return ft;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Run a task and block until it is done
+/// @tparam T Value type
+/// @param _t Task
+/// @return Value of the task
+template<typename T>
+inline T
+sync_wait(task<T> _t) {
+  return spawn(std::move(_t)).get();
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Awaitable counting blocks [begin, end) with several executor tasks
+/// @tparam E Executor
+///
+/// The awaiting coroutine is resumed by whichever task finishes last, or not
+/// suspended at all if the tasks finished during submission (e.g., with an
+/// inline executor), so no thread ever blocks on the chunk.
+////////////////////////////////////////////////////////////////////////////////
+template<typename E>
+struct count_chunk {
+  E& ex;              ///< Executor
+  size_t n;           ///< Samples of the whole run
+  size_t begin;       ///< First block
+  size_t end;         ///< One past the last block
+  uint64_t seed;      ///< Seed
+  size_t width;       ///< Number of tasks
+
+  std::atomic<size_t> next{0};      ///< Next unclaimed block
+  std::atomic<size_t> n_inner{0};   ///< Inner samples of the chunk
+  std::atomic<size_t> remaining{0}; ///< Unfinished tasks plus submitter
+
+  bool await_ready() noexcept { return begin >= end; }
+
+  bool await_suspend(std::coroutine_handle<> _h) {
+    const size_t w = width;
+    next = begin;
+    remaining = w + 1;
+    for(size_t i = 0; i < w; ++i)
+      ex.submit([this, _h]() {
+        size_t c = 0;
+        for(size_t b = next++; b < end; b = next++)
+          c += sequential::count_block(n, b, seed);
+        n_inner += c;
+        // The chunk may be destroyed once the coroutine resumes
+        if(remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+          _h.resume();
+      });
+    return remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+  }
+
+  size_t await_resume() noexcept { return n_inner; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Number of tasks to split a chunk into on an executor
+template<typename E>
+size_t
+parallelism(const E& _ex) {
+  if constexpr(requires { _ex.size(); })
+    return std::max<size_t>(1, _ex.size());
+  else
+    return 1;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi asynchronously, yielding the estimate after every
+///        chunk
+/// @tparam E Executor type
+/// @param _n Number of samples
+/// @param _ex Executor, must outlive the generator
+/// @param _stop Stops the estimation between chunks
+/// @param _seed Seed
+/// @param _chunk_blocks Blocks per chunk, i.e., between yields, at least 1
+/// @return Generator of running estimates
+///
+/// Each chunk is split into as many tasks as the executor has workers. The
+/// consumer resumes on the executor thread that finished the chunk.
+template<coro::executor E>
+coro::async_generator<pi_estimate>
+async_pi(size_t _n, E& _ex, std::stop_token _stop = {}, uint64_t _seed = 0,
+         size_t _chunk_blocks = 16) {
+  const size_t nb = sequential::num_blocks(_n);
+  const size_t width = detail::parallelism(_ex);
+  const size_t chunk = std::max<size_t>(1, _chunk_blocks);
+  pi_estimate e;
+  for(size_t b = 0; b < nb && !_stop.stop_requested(); b += chunk) {
+    size_t end = std::min(nb, b + chunk);
+    e.n_inner += co_await detail::count_chunk<E>{
+      _ex, _n, b, end, _seed, std::min(width, end - b)};
+    e.n = std::min(_n, end*sequential::BLOCK_SIZE);
+    co_yield e;
+  }
+}
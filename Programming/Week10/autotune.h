@@ -0,0 +1,205 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Auto-tuned approximation of pi, choosing threads and chunk size.
+///
+/// On first use the tuner times a short sweep of configurations for a grid of
+/// sample counts on the given pool and stores the fastest configuration per
+/// grid point in a per-host cache file. Later runs, in this or another
+/// process, load the table and dispatch directly. Zero threads stands for
+/// sequential::pi, which wins below the crossover where the overhead of
+/// waking workers dominates.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "benchmark.h"
+#include "parallel_pi.h"
+#include "sequential_pi.h"
+#include "simd_sampling.h"
+#include "thread_pool.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Execution configuration of one call
+////////////////////////////////////////////////////////////////////////////////
+struct tuned_config {
+  size_t threads{0}; ///< Workers, 0 for sequential
+  size_t chunk{0};   ///< Samples per claim, unused when sequential
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Pi with the fastest measured configuration for each sample count
+////////////////////////////////////////////////////////////////////////////////
+class autotuner {
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors and special member functions
+    /// @{
+
+    /// @brief Construct, loading the table if the cache file matches
+    /// @param _pool Pool to run on, its size bounds the thread count
+    /// @param _cache Cache file, see default_cache()
+    /// @param _s Sampling kernel
+    explicit autotuner(thread_pool& _pool,
+                       std::string _cache = default_cache(),
+                       sampler _s = sampler::simd) :
+      m_pool(_pool), m_cache(std::move(_cache)), m_sampler(_s) {
+      load();
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Per-host cache file under $XDG_CACHE_HOME or ~/.cache
+    static std::string default_cache() {
+      std::string dir;
+      if(const char* x = std::getenv("XDG_CACHE_HOME"))
+        dir = x;
+      else if(const char* h = std::getenv("HOME"))
+        dir = std::string(h) + "/.cache";
+      else
+        dir = "/tmp";
+      return dir + "/pi_autotune_" + host() + ".txt";
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Approximate pi, calibrating first if there is no table
+    /// @param _n Number of samples
+    /// @return Approximation of pi
+    double pi(size_t _n) {
+      if(m_table.empty())
+        calibrate();
+      return run(_n, choose(_n));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Configuration for a sample count, from the nearest grid point
+    ///        not above it (the smallest one below the grid)
+    /// @param _n Number of samples
+    tuned_config choose(size_t _n) const {
+      if(m_table.empty())
+        return tuned_config{};
+      auto it = m_table.upper_bound(_n);
+      return it == m_table.begin() ? it->second : std::prev(it)->second;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Table of grid sample counts to configurations
+    const std::map<size_t, tuned_config>& table() const { return m_table; }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Time all candidate configurations on the grid and save the
+    ///        table
+    ///
+    /// Candidates are sequential plus every power of two of threads up to the
+    /// pool size, each with one and with eight chunks per thread.
+    void calibrate() {
+      bench::options opt;
+      opt.warmup = bench::options::duration(2e-3);
+      opt.min_sample = bench::options::duration(5e-4);
+      opt.min_time = bench::options::duration(1e-2);
+      opt.max_time = bench::options::duration(0.2);
+      opt.min_samples = 3;
+
+      m_table.clear();
+      for(size_t n = MIN_N; n <= MAX_N; n *= 4) {
+        std::vector<tuned_config> cs{tuned_config{}};
+        for(size_t nt = 1; nt <= m_pool.size(); nt *= 2)
+          for(size_t per : {1, 8})
+            if(n/(nt*per) >= MIN_CHUNK)
+              cs.push_back(tuned_config{nt, n/(nt*per)});
+
+        tuned_config best;
+        double t_best = INFINITY;
+        for(const tuned_config& c : cs) {
+          double t = bench::run("", [this, n, c]() { return run(n, c); },
+                                opt).median;
+          if(t < t_best) {
+            t_best = t;
+            best = c;
+          }
+        }
+        m_table[n] = best;
+      }
+      save();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Run one configuration
+    /// @param _n Number of samples
+    /// @param _c Configuration
+    /// @return Approximation of pi
+    double run(size_t _n, tuned_config _c) {
+      if(_c.threads == 0)
+        return sequential::pi(_n, m_sampler);
+      return parallel::chunked_pi(_n, std::min(_c.threads, m_pool.size()),
+                                  _c.chunk, m_pool, m_sampler);
+    }
+
+  private:
+    static constexpr size_t MIN_N = size_t(1) << 10;     ///< Smallest grid n
+    static constexpr size_t MAX_N = size_t(1) << 24;     ///< Largest grid n
+    static constexpr size_t MIN_CHUNK = size_t(1) << 10; ///< Smallest chunk
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Host name, "unknown" if not available
+    static std::string host() {
+      char h[256] = {};
+      if(gethostname(h, sizeof(h) - 1) != 0 || !h[0])
+        return "unknown";
+      return h;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Header identifying what the table was measured for
+    std::string header() const {
+      std::string s = m_sampler == sampler::scalar
+                      ? "scalar" : simd::name(simd::best_isa());
+      if(m_sampler == sampler::integer)
+        s += "-int";
+      return "pi-autotune 1 host=" + host() + " pool=" +
+             std::to_string(m_pool.size()) + " sampler=" + s;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Load the table, ignoring files measured for something else
+    void load() {
+      std::ifstream ifs(m_cache);
+      std::string line;
+      if(!std::getline(ifs, line) || line != header())
+        return;
+      size_t n;
+      tuned_config c;
+      while(ifs >> n >> c.threads >> c.chunk)
+        m_table[n] = c;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Save the table, silently skipped if the file cannot be written
+    void save() const {
+      std::error_code ec;
+      std::filesystem::create_directories(
+        std::filesystem::path(m_cache).parent_path(), ec);
+      std::ofstream ofs(m_cache);
+      ofs << header() << '\n';
+      for(const auto& [n, c] : m_table)
+        ofs << n << ' ' << c.threads << ' ' << c.chunk << '\n';
+    }
+
+    thread_pool& m_pool;                    ///< Pool
+    std::string m_cache;                    ///< Cache file
+    sampler m_sampler;                      ///< Sampling kernel
+    std::map<size_t, tuned_config> m_table; ///< Grid n to configuration
+};
@@ -0,0 +1,346 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Small header-only micro benchmark harness.
+///
+/// A benchmark warms up, picks a batch size so that one timed sample is well
+/// above the clock resolution, then takes samples until a minimum count and a
+/// minimum time are reached and the samples agree (their median absolute
+/// deviation is within max_spread of the median), or at the latest until the
+/// maximum time. Results report robust statistics (median, percentiles, median
+/// absolute deviation), can be written as CSV or JSON, and can be compared
+/// against a saved CSV baseline.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Benchmark harness
+////////////////////////////////////////////////////////////////////////////////
+namespace bench {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Optimization barriers
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Force a value to be computed, as if it were read by unknown code
+/// @tparam T Value type
+/// @param _v Value
+template<typename T>
+inline void
+do_not_optimize(const T& _v) {
+  asm volatile("" : : "r,m"(_v) : "memory");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Force a value to be computed and assume it may be modified
+/// @tparam T Value type
+/// @param _v Value
+template<typename T>
+inline void
+do_not_optimize(T& _v) {
+  asm volatile("" : "+r,m"(_v) : : "memory");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Force all pending writes to memory to happen
+inline void
+clobber_memory() {
+  asm volatile("" : : : "memory");
+}
+
+/// @}
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Knobs of a benchmark run
+////////////////////////////////////////////////////////////////////////////////
+struct options {
+  using duration = std::chrono::duration<double>; ///< Seconds
+
+  duration warmup{0.01};      ///< Time spent warming up
+  duration min_sample{1e-3};  ///< Minimum time of one timed sample
+  duration min_time{0.05};    ///< Minimum total time of all samples
+  duration max_time{2.};      ///< Stop sampling after this, once min_samples
+  double max_spread{0.02};    ///< Relative MAD to stop between min and max
+  size_t min_samples{10};     ///< Minimum number of timed samples
+  size_t max_samples{1000};   ///< Maximum number of timed samples
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Statistics of one benchmark, times in seconds per call
+////////////////////////////////////////////////////////////////////////////////
+struct result {
+  std::string name;  ///< Benchmark name
+  size_t batch{0};   ///< Calls per timed sample
+  size_t samples{0}; ///< Timed samples
+  double median{0};  ///< Median
+  double p10{0};     ///< 10th percentile
+  double p90{0};     ///< 90th percentile
+  double mad{0};     ///< Median absolute deviation from the median
+  double mean{0};    ///< Mean
+  double min{0};     ///< Minimum
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Call a function and keep its result alive
+template<typename F>
+void
+call(F& _f) {
+  if constexpr(std::is_void_v<std::invoke_result_t<F&>>)
+    _f();
+  else {
+    auto r = _f();
+    do_not_optimize(r);
+  }
+  clobber_memory();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Percentile of sorted data by linear interpolation
+/// @param _s Sorted data
+/// @param _p Fraction in [0, 1]
+inline double
+percentile(const std::vector<double>& _s, double _p) {
+  double x = _p*(_s.size() - 1);
+  size_t i = size_t(x);
+  if(i + 1 >= _s.size())
+    return _s.back();
+  return _s[i] + (x - i)*(_s[i + 1] - _s[i]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Escape a string for CSV and JSON, quotes are doubled/escaped
+inline std::string
+quoted(const std::string& _s, char _escape) {
+  std::string q = "\"";
+  for(char c : _s) {
+    if(c == '"')
+      q += _escape;
+    q += c;
+  }
+  return q + '"';
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Summarize timed samples
+/// @param _name Benchmark name
+/// @param _batch Calls per sample
+/// @param _s Seconds per call of each sample
+/// @return Statistics
+inline result
+summarize(std::string _name, size_t _batch, std::vector<double> _s) {
+  result r;
+  r.name = std::move(_name);
+  r.batch = _batch;
+  r.samples = _s.size();
+  if(_s.empty())
+    return r;
+
+  std::sort(_s.begin(), _s.end());
+  r.median = detail::percentile(_s, 0.5);
+  r.p10 = detail::percentile(_s, 0.1);
+  r.p90 = detail::percentile(_s, 0.9);
+  r.min = _s.front();
+  double sum = 0;
+  for(double x : _s)
+    sum += x;
+  r.mean = sum/_s.size();
+
+  std::vector<double> dev;
+  dev.reserve(_s.size());
+  for(double x : _s)
+    dev.push_back(std::abs(x - r.median));
+  std::sort(dev.begin(), dev.end());
+  r.mad = detail::percentile(dev, 0.5);
+  return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Benchmark a callable
+/// @tparam F Callable type, its result (if any) is kept alive
+/// @param _name Benchmark name
+/// @param _f Callable
+/// @param _opt Options
+/// @return Statistics in seconds per call
+template<typename F>
+result
+run(std::string _name, F&& _f, const options& _opt = options{}) {
+  using my_clock = std::chrono::steady_clock;
+  using seconds = std::chrono::duration<double>;
+  auto since = [](my_clock::time_point _t) {
+    return std::chrono::duration_cast<seconds>(my_clock::now() - _t);
+  };
+
+  // Warm up caches, branch predictors, page tables, and estimate one call
+  size_t warm = 0;
+  my_clock::time_point start = my_clock::now();
+  do {
+    detail::call(_f);
+    ++warm;
+  } while(since(start) < _opt.warmup);
+  double per_call = since(start).count()/warm;
+
+  // Batch enough calls per sample to be well above the clock resolution
+  size_t batch = std::max<size_t>(1,
+    size_t(std::ceil(_opt.min_sample.count()/std::max(per_call, 1e-12))));
+
+  std::vector<double> s;
+  start = my_clock::now();
+  while(s.size() < _opt.max_samples) {
+    my_clock::time_point t = my_clock::now();
+    for(size_t i = 0; i < batch; ++i)
+      detail::call(_f);
+    s.push_back(since(t).count()/batch);
+
+    // Stop at min_time once the samples agree, at max_time regardless
+    seconds total = since(start);
+    if(s.size() < _opt.min_samples || total < _opt.min_time)
+      continue;
+    if(total >= _opt.max_time)
+      break;
+    result r = summarize("", batch, s);
+    if(r.mad <= _opt.max_spread*r.median)
+      break;
+  }
+  return summarize(std::move(_name), batch, std::move(s));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Output
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write results as CSV with a header line
+inline void
+write_csv(std::ostream& _os, const std::vector<result>& _rs) {
+  _os << "name,batch,samples,median,p10,p90,mad,mean,min\n";
+  _os << std::setprecision(9) << std::scientific;
+  for(const result& r : _rs)
+    _os << detail::quoted(r.name, '"') << ',' << r.batch << ',' << r.samples
+        << ',' << r.median << ',' << r.p10 << ',' << r.p90 << ',' << r.mad
+        << ',' << r.mean << ',' << r.min << '\n';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write results as a JSON array of objects
+inline void
+write_json(std::ostream& _os, const std::vector<result>& _rs) {
+  _os << "[\n" << std::setprecision(9) << std::scientific;
+  for(size_t i = 0; i < _rs.size(); ++i) {
+    const result& r = _rs[i];
+    _os << "  {\"name\": " << detail::quoted(r.name, '\\')
+        << ", \"batch\": " << r.batch << ", \"samples\": " << r.samples
+        << ", \"median\": " << r.median << ", \"p10\": " << r.p10
+        << ", \"p90\": " << r.p90 << ", \"mad\": " << r.mad
+        << ", \"mean\": " << r.mean << ", \"min\": " << r.min << "}"
+        << (i + 1 < _rs.size() ? ",\n" : "\n");
+  }
+  _os << "]\n";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read results written by write_csv
+/// @param _is Input
+/// @return Results
+inline std::vector<result>
+read_csv(std::istream& _is) {
+  std::vector<result> rs;
+  std::string line;
+  std::getline(_is, line); // Header
+  while(std::getline(_is, line)) {
+    if(line.empty())
+      continue;
+    result r;
+    size_t pos = 0;
+    if(line[0] == '"') {
+      for(pos = 1; pos < line.size(); ++pos) {
+        if(line[pos] == '"' && pos + 1 < line.size() && line[pos + 1] == '"')
+          r.name += line[++pos];
+        else if(line[pos] == '"')
+          break;
+        else
+          r.name += line[pos];
+      }
+      pos += 2;
+    }
+    else {
+      size_t c = line.find(',');
+      r.name = line.substr(0, c);
+      pos = c + 1;
+    }
+    std::istringstream fields(line.substr(pos));
+    char comma;
+    fields >> r.batch >> comma >> r.samples >> comma >> r.median >> comma
+           >> r.p10 >> comma >> r.p90 >> comma >> r.mad >> comma >> r.mean
+           >> comma >> r.min;
+    rs.push_back(r);
+  }
+  return rs;
+}
+
+/// @}
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Comparison of one benchmark against its baseline
+////////////////////////////////////////////////////////////////////////////////
+struct comparison {
+  std::string name; ///< Benchmark name
+  double baseline;  ///< Baseline median
+  double current;   ///< Current median
+  bool regression;  ///< Slower beyond threshold and noise
+  bool improvement; ///< Faster beyond threshold and noise
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compare results against a baseline by name
+/// @param _rs Current results
+/// @param _base Baseline results
+/// @param _threshold Relative change of the median to flag
+/// @return One comparison per benchmark present in both
+///
+/// A change is only flagged if the medians differ by more than
+/// @c _threshold and the p10-p90 ranges of the two runs do not overlap, so
+/// noisy benchmarks need a clear shift to be reported.
+inline std::vector<comparison>
+compare(const std::vector<result>& _rs, const std::vector<result>& _base,
+        double _threshold = 0.05) {
+  std::map<std::string, const result*> base;
+  for(const result& b : _base)
+    base[b.name] = &b;
+
+  std::vector<comparison> cs;
+  for(const result& r : _rs) {
+    auto it = base.find(r.name);
+    if(it == base.end())
+      continue;
+    const result& b = *it->second;
+    comparison c{r.name, b.median, r.median, false, false};
+    c.regression = r.median > b.median*(1 + _threshold) && r.p10 > b.p90;
+    c.improvement = r.median < b.median*(1 - _threshold) && r.p90 < b.p10;
+    cs.push_back(c);
+  }
+  return cs;
+}
+
+}
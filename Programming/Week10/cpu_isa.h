@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Instruction sets of the running CPU, for dispatching SIMD kernels.
+///
+/// Defines CPU_ISA_X86 and includes the x86 intrinsics on x86 targets, so
+/// kernels can be guarded by one macro and compiled per instruction set with
+/// __attribute__((target(...))).
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_ISA_X86
+#endif
+
+namespace simd {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Instruction sets of the SIMD kernels
+////////////////////////////////////////////////////////////////////////////////
+enum class isa {
+  scalar,
+  sse2,
+  avx2,
+  avx512
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Check whether the running CPU supports an instruction set
+/// @param _i Instruction set
+/// @return True if kernels for @c _i can run
+inline bool
+supported(isa _i) {
+#ifdef CPU_ISA_X86
+  switch(_i) {
+    case isa::scalar: return true;
+    case isa::sse2:   return __builtin_cpu_supports("sse2");
+    case isa::avx2:   return __builtin_cpu_supports("avx2");
+    case isa::avx512: return __builtin_cpu_supports("avx512f");
+  }
+  return false;
+#else
+  return _i == isa::scalar;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Widest instruction set supported by the running CPU
+inline isa
+best_isa() {
+  static const isa best = []() {
+    for(isa i : {isa::avx512, isa::avx2, isa::sse2})
+      if(supported(i))
+        return i;
+    return isa::scalar;
+  }();
+  return best;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Name of an instruction set
+inline const char*
+name(isa _i) {
+  switch(_i) {
+    case isa::scalar: return "scalar";
+    case isa::sse2:   return "sse2";
+    case isa::avx2:   return "avx2";
+    case isa::avx512: return "avx512";
+  }
+  return "unknown";
+}
+
+}
@@ -0,0 +1,559 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Deterministic approximation of pi to many digits (Chudnovsky).
+///
+/// The Chudnovsky series
+///   1/pi = 12 sum_k (-1)^k (6k)! (13591409 + 545140134k)
+///                    / ((3k)! (k!)^3 640320^(3k + 3/2))
+/// adds about 14.18 digits per term. Its partial sums are evaluated exactly by
+/// binary splitting into integers P, Q and T, after which
+///   pi = 426880 sqrt(10005) Q/T
+/// is computed in fixed point with Newton iterations for 1/sqrt(10005) and for
+/// the reciprocal of T. All arithmetic runs on bigint, a sign-magnitude integer
+/// of base 10^9 limbs with Karatsuba multiplication, so digits print directly.
+/// The two halves of each node of the splitting tree run on separate threads
+/// down to the requested thread count.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Collection of deterministic algorithms
+////////////////////////////////////////////////////////////////////////////////
+namespace deterministic {
+
+constexpr uint32_t BASE = 1'000'000'000; ///< Limb base
+constexpr size_t BASE_DIGITS = 9;        ///< Decimal digits per limb
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+/// @brief Magnitude, little-endian limbs without leading zero limbs
+using limbs = std::vector<uint32_t>;
+
+/// @brief Below this many limbs in the shorter operand multiply schoolbook
+constexpr size_t KARATSUBA_THRESHOLD = 48;
+
+/// @brief Below this many terms split the series on the calling thread
+constexpr size_t MIN_PARALLEL_TERMS = 64;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Drop leading zero limbs
+inline void
+trim(limbs& _a) {
+  while(!_a.empty() && _a.back() == 0)
+    _a.pop_back();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compare magnitudes
+/// @return Negative, zero, or positive as @c _a is less, equal, or greater
+inline int
+compare(const limbs& _a, const limbs& _b) {
+  if(_a.size() != _b.size())
+    return _a.size() < _b.size() ? -1 : 1;
+  for(size_t i = _a.size(); i-- > 0;)
+    if(_a[i] != _b[i])
+      return _a[i] < _b[i] ? -1 : 1;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Add a shifted magnitude in place, _a += _b*BASE^_shift
+/// @param _a Sum
+/// @param _b Limbs of the addend
+/// @param _nb Number of limbs of the addend
+/// @param _shift Limbs to shift the addend by
+inline void
+add_to(limbs& _a, const uint32_t* _b, size_t _nb, size_t _shift = 0) {
+  if(_a.size() < _shift + _nb)
+    _a.resize(_shift + _nb, 0);
+  uint32_t carry = 0;
+  size_t i = _shift;
+  for(size_t j = 0; j < _nb; ++i, ++j) {
+    uint32_t s = _a[i] + _b[j] + carry;
+    carry = s >= BASE;
+    _a[i] = carry ? s - BASE : s;
+  }
+  for(; carry; ++i) {
+    if(i == _a.size())
+      _a.push_back(0);
+    carry = _a[i] == BASE - 1;
+    _a[i] = carry ? 0 : _a[i] + 1;
+  }
+  trim(_a);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Subtract a shifted magnitude in place, _a -= _b*BASE^_shift
+/// @param _a Difference, must not be less than the subtrahend
+/// @param _b Limbs of the subtrahend
+/// @param _nb Number of limbs of the subtrahend
+/// @param _shift Limbs to shift the subtrahend by
+inline void
+sub_from(limbs& _a, const uint32_t* _b, size_t _nb, size_t _shift = 0) {
+  uint32_t borrow = 0;
+  size_t i = _shift;
+  for(size_t j = 0; j < _nb; ++i, ++j) {
+    int64_t d = int64_t(_a[i]) - _b[j] - borrow;
+    borrow = d < 0;
+    _a[i] = uint32_t(borrow ? d + BASE : d);
+  }
+  for(; borrow; ++i) {
+    borrow = _a[i] == 0;
+    _a[i] = borrow ? BASE - 1 : _a[i] - 1;
+  }
+  trim(_a);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Schoolbook product
+/// @param _a Limbs of the first factor
+/// @param _na Number of limbs of the first factor
+/// @param _b Limbs of the second factor
+/// @param _nb Number of limbs of the second factor
+/// @return Product
+inline limbs
+mul_schoolbook(const uint32_t* _a, size_t _na, const uint32_t* _b,
+               size_t _nb) {
+  limbs r(_na + _nb, 0);
+  for(size_t i = 0; i < _na; ++i) {
+    uint64_t carry = 0;
+    for(size_t j = 0; j < _nb; ++j) {
+      uint64_t cur = r[i + j] + uint64_t(_a[i])*_b[j] + carry;
+      r[i + j] = uint32_t(cur%BASE);
+      carry = cur/BASE;
+    }
+    r[i + _nb] = uint32_t(carry);
+  }
+  trim(r);
+  return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Karatsuba product, schoolbook below KARATSUBA_THRESHOLD
+/// @param _a Limbs of the first factor
+/// @param _na Number of limbs of the first factor
+/// @param _b Limbs of the second factor
+/// @param _nb Number of limbs of the second factor
+/// @return Product
+inline limbs
+mul(const uint32_t* _a, size_t _na, const uint32_t* _b, size_t _nb) {
+  if(_na < _nb)
+    return mul(_b, _nb, _a, _na);
+  if(_nb < KARATSUBA_THRESHOLD)
+    return mul_schoolbook(_a, _na, _b, _nb);
+
+  // Split the longer factor at m, a = a1 BASE^m + a0
+  const size_t m = _na/2;
+  if(_nb <= m) {
+    limbs r = mul(_a, m, _b, _nb);
+    limbs hi = mul(_a + m, _na - m, _b, _nb);
+    add_to(r, hi.data(), hi.size(), m);
+    return r;
+  }
+
+  // (a1 B^m + a0)(b1 B^m + b0) = z2 B^2m + z1 B^m + z0 with
+  // z1 = (a1 + a0)(b1 + b0) - z2 - z0
+  limbs z0 = mul(_a, m, _b, m);
+  limbs z2 = mul(_a + m, _na - m, _b + m, _nb - m);
+  limbs sa(_a, _a + m), sb(_b, _b + m);
+  trim(sa);
+  trim(sb);
+  add_to(sa, _a + m, _na - m);
+  add_to(sb, _b + m, _nb - m);
+  limbs z1 = mul(sa.data(), sa.size(), sb.data(), sb.size());
+  sub_from(z1, z0.data(), z0.size());
+  sub_from(z1, z2.data(), z2.size());
+
+  limbs r = std::move(z0);
+  add_to(r, z1.data(), z1.size(), m);
+  add_to(r, z2.data(), z2.size(), 2*m);
+  return r;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Arbitrary precision signed integer
+////////////////////////////////////////////////////////////////////////////////
+class bigint {
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors
+    /// @{
+
+    /// @brief Construct from a machine integer
+    /// @param _v Value
+    explicit bigint(int64_t _v = 0) : m_neg(_v < 0) {
+      uint64_t v = _v < 0 ? 0 - uint64_t(_v) : uint64_t(_v);
+      for(; v; v /= BASE)
+        m_mag.push_back(uint32_t(v%BASE));
+    }
+
+    /// @brief BASE^_k
+    /// @param _k Exponent
+    static bigint base_pow(size_t _k) {
+      bigint r;
+      r.m_mag.assign(_k + 1, 0);
+      r.m_mag.back() = 1;
+      return r;
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Accessors
+    /// @{
+
+    /// @brief Number of limbs of the magnitude, 0 for zero
+    size_t size() const { return m_mag.size(); }
+
+    /// @brief Limb of the magnitude, 0 beyond the top
+    /// @param _i Limb index
+    uint32_t limb(size_t _i) const {
+      return _i < m_mag.size() ? m_mag[_i] : 0;
+    }
+
+    /// @brief Check for zero
+    bool is_zero() const { return m_mag.empty(); }
+
+    /// @brief Check for a negative value
+    bool is_negative() const { return m_neg; }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Arithmetic
+    /// @{
+
+    /// @brief Negation
+    bigint operator-() const {
+      bigint r = *this;
+      r.m_neg = !r.m_neg && !r.is_zero();
+      return r;
+    }
+
+    /// @brief Sum
+    friend bigint operator+(const bigint& _a, const bigint& _b) {
+      bigint r;
+      if(_a.m_neg == _b.m_neg) {
+        r = _a;
+        detail::add_to(r.m_mag, _b.m_mag.data(), _b.size());
+      }
+      else if(detail::compare(_a.m_mag, _b.m_mag) >= 0) {
+        r = _a;
+        detail::sub_from(r.m_mag, _b.m_mag.data(), _b.size());
+      }
+      else {
+        r = _b;
+        detail::sub_from(r.m_mag, _a.m_mag.data(), _a.size());
+      }
+      r.m_neg = r.m_neg && !r.is_zero();
+      return r;
+    }
+
+    /// @brief Difference
+    friend bigint operator-(const bigint& _a, const bigint& _b) {
+      return _a + -_b;
+    }
+
+    /// @brief Product
+    friend bigint operator*(const bigint& _a, const bigint& _b) {
+      bigint r;
+      r.m_mag = detail::mul(_a.m_mag.data(), _a.size(), _b.m_mag.data(),
+                            _b.size());
+      r.m_neg = _a.m_neg != _b.m_neg && !r.is_zero();
+      return r;
+    }
+
+    /// @brief Multiply by a small factor
+    bigint& operator*=(uint32_t _f) {
+      uint64_t carry = 0;
+      for(uint32_t& l : m_mag) {
+        uint64_t cur = uint64_t(l)*_f + carry;
+        l = uint32_t(cur%BASE);
+        carry = cur/BASE;
+      }
+      for(; carry; carry /= BASE)
+        m_mag.push_back(uint32_t(carry%BASE));
+      detail::trim(m_mag);
+      m_neg = m_neg && !is_zero();
+      return *this;
+    }
+
+    /// @brief Divide by a small divisor, rounding toward zero
+    bigint& operator/=(uint32_t _d) {
+      uint64_t rem = 0;
+      for(size_t i = m_mag.size(); i-- > 0;) {
+        uint64_t cur = rem*BASE + m_mag[i];
+        m_mag[i] = uint32_t(cur/_d);
+        rem = cur%_d;
+      }
+      detail::trim(m_mag);
+      m_neg = m_neg && !is_zero();
+      return *this;
+    }
+
+    /// @brief Multiply by BASE^_k, or divide by BASE^-_k rounding toward zero
+    /// @param _k Limbs to shift by
+    bigint shifted(std::ptrdiff_t _k) const {
+      bigint r = *this;
+      if(_k >= 0)
+        r.m_mag.insert(r.m_mag.begin(), size_t(_k), 0);
+      else if(size_t(-_k) >= r.size())
+        r = bigint();
+      else
+        r.m_mag.erase(r.m_mag.begin(), r.m_mag.begin() + -_k);
+      return r;
+    }
+
+    /// @brief Three-way comparison
+    friend int compare(const bigint& _a, const bigint& _b) {
+      if(_a.m_neg != _b.m_neg)
+        return _a.m_neg ? -1 : 1;
+      int c = detail::compare(_a.m_mag, _b.m_mag);
+      return _a.m_neg ? -c : c;
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Decimal representation
+    std::string to_string() const {
+      if(is_zero())
+        return "0";
+      std::string s = (m_neg ? "-" : "") + std::to_string(m_mag.back());
+      s.reserve(s.size() + BASE_DIGITS*(m_mag.size() - 1));
+      for(size_t i = m_mag.size() - 1; i-- > 0;) {
+        std::string l = std::to_string(m_mag[i]);
+        s.append(BASE_DIGITS - l.size(), '0').append(l);
+      }
+      return s;
+    }
+
+  private:
+    bool m_neg{false};   ///< Sign, never set for zero
+    detail::limbs m_mag; ///< Magnitude
+};
+
+namespace detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief One Newton step for a reciprocal, r + r(BASE^k - x r)/BASE^k
+/// @param _r Approximation of BASE^_k/_x
+/// @param _x Divisor
+/// @param _k Scale in limbs
+/// @return Correction to add to @c _r
+inline bigint
+reciprocal_step(const bigint& _r, const bigint& _x, size_t _k) {
+  return (_r*(bigint::base_pow(_k) - _x*_r)).shifted(-std::ptrdiff_t(_k));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reciprocal of a divisor of _p limbs with doubling precision
+/// @param _x Positive divisor of @c _p limbs
+/// @param _p Limbs of the divisor
+/// @return Approximation of BASE^(2 _p)/_x, off by a few units at most
+///
+/// Each level halves the precision of the divisor, so one Newton step at full
+/// precision suffices on top of the recursion and the total cost is a small
+/// multiple of one full product.
+inline bigint
+reciprocal_normalized(const bigint& _x, size_t _p) {
+  if(_p > 4) {
+    const size_t h = _p/2 + 2;
+    const std::ptrdiff_t s = std::ptrdiff_t(_p - h);
+    bigint r = reciprocal_normalized(_x.shifted(-s), h).shifted(s);
+    return r + reciprocal_step(r, _x, 2*_p);
+  }
+
+  // Start from 15 digits: _x is about top*BASE^(_p - 3)
+  double top = 0;
+  for(size_t i = 1; i <= 3; ++i)
+    top = top*BASE + (_p >= i ? _x.limb(_p - i) : 0);
+  bigint r = bigint(int64_t(1e36/top)).shifted(std::ptrdiff_t(_p) - 1);
+  for(size_t it = 0; it < 64; ++it) {
+    bigint delta = reciprocal_step(r, _x, 2*_p);
+    if(delta.is_zero())
+      break;
+    r = r + delta;
+  }
+  return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reciprocal by Newton iteration
+/// @param _d Positive divisor
+/// @param _k Scale in limbs, at least _d.size() + 1
+/// @return Approximation of BASE^_k/_d, off by a few units at most
+inline bigint
+reciprocal(const bigint& _d, size_t _k) {
+  // Two more limbs of the divisor than of the result
+  const size_t nd = _d.size();
+  const size_t p = _k - nd + 2;
+  bigint x = _d.shifted(std::ptrdiff_t(p) - std::ptrdiff_t(nd));
+  return reciprocal_normalized(x, p).shifted(-2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Quotient of non-negative integers, rounded down
+/// @param _n Dividend
+/// @param _d Divisor, positive
+/// @return _n/_d
+inline bigint
+divide(const bigint& _n, const bigint& _d) {
+  if(_d.is_zero() || _d.is_negative() || _n.is_negative())
+    throw std::invalid_argument("Divide expects _n >= 0 and _d > 0.");
+  if(compare(_n, _d) < 0)
+    return bigint();
+
+  const size_t k = _n.size() + 1;
+  bigint q = (_n*reciprocal(_d, k)).shifted(-std::ptrdiff_t(k));
+
+  // Correct the last units
+  bigint rem = _n - q*_d;
+  while(rem.is_negative()) {
+    q = q - bigint(1);
+    rem = rem + _d;
+  }
+  while(compare(rem, _d) >= 0) {
+    q = q + bigint(1);
+    rem = rem - _d;
+  }
+  return q;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief One Newton step for an inverse square root,
+///        y + y(BASE^2l - x y^2)/(2 BASE^2l)
+/// @param _y Approximation of BASE^_l/sqrt(_x)
+/// @param _x Radicand
+/// @param _l Fraction limbs
+/// @return Correction to add to @c _y
+inline bigint
+inv_sqrt_step(const bigint& _y, uint32_t _x, size_t _l) {
+  bigint xy2 = _y*_y;
+  xy2 *= _x;
+  bigint delta = (_y*(bigint::base_pow(2*_l) - xy2))
+                   .shifted(-2*std::ptrdiff_t(_l));
+  delta /= 2;
+  return delta;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Inverse square root in fixed point with doubling precision
+/// @param _x Radicand
+/// @param _l Fraction limbs, at least 2
+/// @return Approximation of BASE^_l/sqrt(_x), off by a few units at most
+inline bigint
+inv_sqrt(uint32_t _x, size_t _l) {
+  if(_l > 4) {
+    const size_t h = _l/2 + 2;
+    bigint y = inv_sqrt(_x, h).shifted(std::ptrdiff_t(_l - h));
+    return y + inv_sqrt_step(y, _x, _l);
+  }
+
+  bigint y = bigint(int64_t(1e18/std::sqrt(double(_x))))
+               .shifted(std::ptrdiff_t(_l) - 2);
+  for(size_t it = 0; it < 64; ++it) {
+    bigint delta = inv_sqrt_step(y, _x, _l);
+    if(delta.is_zero())
+      break;
+    y = y + delta;
+  }
+  return y;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Binary splitting terms of a range of the series
+////////////////////////////////////////////////////////////////////////////////
+struct pqt {
+  bigint p; ///< Product of the numerators
+  bigint q; ///< Product of the denominators
+  bigint t; ///< Partial sum, scaled by q
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Binary splitting of the Chudnovsky series over terms [_a, _b)
+/// @param _a First term
+/// @param _b One past the last term
+/// @param _nt Threads available to this subtree
+/// @return P, Q and T of the range
+inline pqt
+split(size_t _a, size_t _b, size_t _nt) {
+  if(_b - _a == 1) {
+    if(_a == 0)
+      return {bigint(1), bigint(1), bigint(13591409)};
+    // p = (6a - 5)(2a - 1)(6a - 1), q = a^3 640320^3/24
+    bigint p{int64_t(6*_a - 5)};
+    p *= uint32_t(2*_a - 1);
+    p *= uint32_t(6*_a - 1);
+    bigint q{int64_t(_a)};
+    q *= uint32_t(_a);
+    q *= uint32_t(_a);
+    q *= 640320;
+    q *= 640320;
+    q *= 26680;
+    bigint t = p*bigint(int64_t(13591409 + 545140134*_a));
+    return {p, q, _a%2 ? -t : t};
+  }
+
+  const size_t m = (_a + _b)/2;
+  pqt l, r;
+  if(_nt > 1 && _b - _a >= MIN_PARALLEL_TERMS) {
+    std::future<pqt> left = std::async(std::launch::async, split, _a, m,
+                                       _nt/2);
+    r = split(m, _b, _nt - _nt/2);
+    l = left.get();
+  }
+  else {
+    l = split(_a, m, 1);
+    r = split(m, _b, 1);
+  }
+  return {l.p*r.p, l.q*r.q, l.t*r.q + l.p*r.t};
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi to a number of decimal digits
+/// @param _digits Digits after the decimal point
+/// @param _nt Number of threads splitting the series
+/// @return "3." followed by @c _digits digits, truncated
+///
+/// Two guard limbs absorb the error of the Newton iterations, so the digits are
+/// exact unless the 18 digits after the last one are all 0 or all 9.
+inline std::string
+pi(size_t _digits, size_t _nt = std::thread::hardware_concurrency()) {
+  constexpr double DIGITS_PER_TERM = 14.181647462725477;
+  const size_t l = _digits/BASE_DIGITS + 2;
+  const size_t n = size_t(_digits/DIGITS_PER_TERM) + 2;
+
+  detail::pqt s = detail::split(0, n, std::max<size_t>(1, _nt));
+
+  // pi = 426880 sqrt(10005) Q/T = 426880*10005 Q/(sqrt(10005) T)
+  bigint num = s.q*detail::inv_sqrt(10005, l);
+  num *= 426880;
+  num *= 10005;
+  std::string d = detail::divide(num, s.t).to_string();
+  return d.substr(0, 1) + "." + d.substr(1, _digits);
+}
+
+}
@@ -0,0 +1,217 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Variance-reduced and quasi-monte carlo samplers for pi.
+///
+/// Every sampler is random access: sample i of a run of n samples is a pure
+/// function of (seed, n, i). Any range of samples can therefore be counted on
+/// any thread, which lets all of them share the block driver of
+/// sequential::reproducible_pi and parallel::reproducible_pi.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "rng.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Choice of estimator for the block-based pi functions
+////////////////////////////////////////////////////////////////////////////////
+enum class estimator {
+  uniform,    ///< Plain monte carlo, O(1/sqrt(n))
+  halton,     ///< Randomly shifted Halton sequence (bases 2, 3)
+  sobol,      ///< Digitally shifted Sobol sequence
+  stratified, ///< One sample per cell of a sqrt(n) x sqrt(n) grid
+  antithetic  ///< Pairs of a sample and its reflection
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Samplers behind each estimator
+////////////////////////////////////////////////////////////////////////////////
+namespace estimators {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+/// @brief Philox stream reserved for per-sample randoms of an estimator, far
+///        away from the block streams used by plain sampling.
+constexpr uint64_t SAMPLE_STREAM = uint64_t(1) << 63;
+/// @brief Philox stream reserved for the random shift of a sequence
+constexpr uint64_t SHIFT_STREAM = SAMPLE_STREAM + 1;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Two uniform doubles in [0, 1) for a counter value
+/// @param _seed Seed
+/// @param _stream Philox stream
+/// @param _c Counter
+/// @param _u Output
+inline void
+uniform2(uint64_t _seed, uint64_t _stream, uint64_t _c, double _u[2]) {
+  rng::philox4x32::block_type o = rng::philox4x32{_seed, _stream}.generate(_c);
+  _u[0] = rng::to_unit(uint64_t(o[0]) << 32 | o[1]);
+  _u[1] = rng::to_unit(uint64_t(o[2]) << 32 | o[3]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Test a point of [0, 1)^2 against the inscribed circle
+constexpr bool
+inside(double _u, double _v) {
+  double x = _u - 0.5;
+  double y = _v - 0.5;
+  return x*x + y*y < 0.25;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Radical inverse of an index
+/// @param _i Index
+/// @param _b Base
+/// @return Digits of @c _i in base @c _b mirrored about the radix point
+inline double
+radical_inverse(uint64_t _i, uint64_t _b) {
+  double inv = 1./_b;
+  double f = inv;
+  double r = 0.;
+  for(; _i > 0; _i /= _b, f *= inv)
+    r += f*(_i % _b);
+  return r;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Halton points (bases 2 and 3) with a Cranley-Patterson rotation
+/// @param _begin First sample
+/// @param _end One past the last sample
+/// @param _seed Seed of the random shift
+/// @return Number of inner samples
+inline size_t
+count_halton(size_t _begin, size_t _end, uint64_t _seed) {
+  double shift[2];
+  detail::uniform2(_seed, detail::SHIFT_STREAM, 0, shift);
+
+  size_t n_inner = 0;
+  for(size_t i = _begin; i < _end; ++i) {
+    double u = detail::radical_inverse(i + 1, 2) + shift[0];
+    double v = detail::radical_inverse(i + 1, 3) + shift[1];
+    n_inner += detail::inside(u - std::floor(u), v - std::floor(v));
+  }
+  return n_inner;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Two-dimensional Sobol points with a random digital shift
+/// @param _begin First sample
+/// @param _end One past the last sample
+/// @param _seed Seed of the random shift
+/// @return Number of inner samples
+///
+/// The first dimension is the base 2 van der Corput sequence, the second uses
+/// the primitive polynomial x + 1, i.e., v_1 = 1/2 and v_k = v_{k-1} ^
+/// (v_{k-1} >> 1). Point i is the xor of the direction numbers of the set bits
+/// of i; consecutive points differ by a prefix xor of direction numbers.
+inline size_t
+count_sobol(size_t _begin, size_t _end, uint64_t _seed) {
+  // Prefix xors of direction numbers, 64-bit fixed point
+  uint64_t px[64], py[64];
+  uint64_t vx = uint64_t(1) << 63, vy = uint64_t(1) << 63;
+  px[0] = vx;
+  py[0] = vy;
+  for(int k = 1; k < 64; ++k) {
+    vx >>= 1;
+    vy ^= vy >> 1;
+    px[k] = px[k-1] ^ vx;
+    py[k] = py[k-1] ^ vy;
+  }
+
+  // Digital shift and first point directly
+  rng::philox4x32::block_type o =
+    rng::philox4x32{_seed, detail::SHIFT_STREAM}.generate(0);
+  uint64_t x = uint64_t(o[0]) << 32 | o[1];
+  uint64_t y = uint64_t(o[2]) << 32 | o[3];
+  for(int k = 0; k < 64; ++k)
+    if(_begin & (uint64_t(1) << k)) {
+      x ^= px[k] ^ (k > 0 ? px[k-1] : 0);
+      y ^= py[k] ^ (k > 0 ? py[k-1] : 0);
+    }
+
+  size_t n_inner = 0;
+  for(size_t i = _begin; i < _end; ++i) {
+    n_inner += detail::inside(rng::to_unit(x), rng::to_unit(y));
+    // Incrementing i flips its trailing ones and the zero above them
+    int k = __builtin_ctzll(i + 1);
+    x ^= px[k];
+    y ^= py[k];
+  }
+  return n_inner;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Stratified sampling on a k x k grid, k = floor(sqrt(n))
+/// @param _n Number of samples of the whole run
+/// @param _begin First sample
+/// @param _end One past the last sample
+/// @param _seed Seed
+/// @return Number of inner samples
+///
+/// Sample j < k^2 is uniform within cell j; the remaining n - k^2 samples are
+/// uniform over the whole square, which keeps the estimate unbiased.
+inline size_t
+count_stratified(size_t _n, size_t _begin, size_t _end, uint64_t _seed) {
+  size_t k = size_t(std::sqrt(double(_n)));
+  while(k*k > _n)
+    --k;
+  while((k + 1)*(k + 1) <= _n)
+    ++k;
+  const double h = 1./k;
+
+  size_t n_inner = 0;
+  for(size_t j = _begin; j < _end; ++j) {
+    double u[2];
+    detail::uniform2(_seed, detail::SAMPLE_STREAM, j, u);
+    if(j < k*k)
+      n_inner += detail::inside((j/k + u[0])*h, (j%k + u[1])*h);
+    else
+      n_inner += detail::inside(u[0], u[1]);
+  }
+  return n_inner;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Antithetic pairs of samples
+/// @param _begin First sample
+/// @param _end One past the last sample
+/// @param _seed Seed
+/// @return Number of inner samples
+///
+/// The indicator is symmetric under sign flips, so the textbook partner -x is
+/// useless. Instead each centered coordinate c is paired with
+/// sign(c)*(0.5 - |c|), which is equally distributed but maps the center of the
+/// square to its edge, negatively correlating the two indicators (correlation
+/// about -0.27, i.e., roughly 15% lower error than uniform for the same n).
+/// Samples 2p and 2p+1 form pair p.
+inline size_t
+count_antithetic(size_t _begin, size_t _end, uint64_t _seed) {
+  auto reflect = [](double _c) {
+    return _c < 0 ? -0.5 - _c : 0.5 - _c;
+  };
+
+  size_t n_inner = 0;
+  for(size_t j = _begin; j < _end; ++j) {
+    double u[2];
+    detail::uniform2(_seed, detail::SAMPLE_STREAM, j/2, u);
+    double x = u[0] - 0.5;
+    double y = u[1] - 0.5;
+    if(j % 2) {
+      x = reflect(x);
+      y = reflect(y);
+    }
+    n_inner += x*x + y*y < 0.25;
+  }
+  return n_inner;
+}
+
+}
@@ -0,0 +1,343 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Generic monte carlo integration over boxes of any dimension.
+///
+/// The integrand is a template parameter, so lambdas are inlined into the
+/// sampling loop (no std::function). It evaluates either one point or a batch
+/// of points in structure-of-arrays layout; only a batch integrand lets the
+/// SIMD policy evaluate points in vector lanes, for a point integrand that
+/// policy vectorizes the reduction alone. Samples are split into the same
+/// logical blocks as sequential::reproducible_pi, each with its own Philox
+/// stream, and per-block sums are combined in block order. The sequential and
+/// thread pool policies therefore return identical results; the SIMD policy
+/// only changes the summation order inside a block.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <future>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "rng.h"
+#include "sequential_pi.h"
+#include "thread_pool.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Monte carlo integration
+////////////////////////////////////////////////////////////////////////////////
+namespace mc {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Point in D dimensions
+template<size_t D>
+using point = std::array<double, D>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Integrand of one point, double(const point<D>&)
+template<typename F, size_t D>
+concept point_integrand =
+  std::is_invocable_r_v<double, F&, const point<D>&>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Integrand of a batch of points,
+///        void(const double* _x, size_t _m, double* _y)
+///
+/// Coordinate d of point j is _x[d*_m + j], and f of point j goes to _y[j], so
+/// a loop over j maps to vector lanes.
+template<typename F, size_t D>
+concept batch_integrand =
+  std::is_invocable_v<F&, const double*, size_t, double*>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Axis aligned box [lo, hi)
+/// @tparam D Dimension
+////////////////////////////////////////////////////////////////////////////////
+template<size_t D>
+struct domain {
+  point<D> lo; ///< Lower corner
+  point<D> hi; ///< Upper corner
+
+  /// @brief Volume of the box
+  double volume() const {
+    double v = 1.;
+    for(size_t d = 0; d < D; ++d)
+      v *= hi[d] - lo[d];
+    return v;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Estimate of an integral
+////////////////////////////////////////////////////////////////////////////////
+struct result {
+  double value{0};     ///< Estimate
+  double std_error{0}; ///< Standard error of the estimate
+  size_t n{0};         ///< Samples
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Execution policies
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Run all blocks on the calling thread
+////////////////////////////////////////////////////////////////////////////////
+struct sequential_policy {
+  bool simd{false}; ///< Use the vectorizable kernel
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Run blocks on a thread pool
+////////////////////////////////////////////////////////////////////////////////
+struct pool_policy {
+  thread_pool& pool; ///< Pool
+  size_t nt;         ///< Number of workers submitted to the pool
+  bool simd{false};  ///< Use the vectorizable kernel
+};
+
+constexpr sequential_policy seq{false}; ///< Sequential, scalar kernel
+constexpr sequential_policy simd{true}; ///< Sequential, vectorizable kernel
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Thread pool policy using all workers of a pool
+/// @param _pool Pool
+/// @param _simd Use the vectorizable kernel
+inline pool_policy
+par(thread_pool& _pool, bool _simd = false) {
+  return pool_policy{_pool, _pool.size(), _simd};
+}
+
+/// @}
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+constexpr size_t BATCH = 256; ///< Points generated per batch
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Sums of f and f^2 over a block
+////////////////////////////////////////////////////////////////////////////////
+struct sums {
+  double s{0};  ///< Sum of f
+  double s2{0}; ///< Sum of f^2
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Integrate over one logical block
+/// @tparam D Dimension
+/// @tparam F Integrand, point_integrand or batch_integrand
+/// @param _f Integrand
+/// @param _dom Domain
+/// @param _n Number of samples of the whole run
+/// @param _b Block index
+/// @param _seed Seed
+/// @param _simd Use the vectorizable kernel
+/// @return Sums of f and f^2 over the block
+///
+/// Both kernels draw the same points, D doubles per point. The scalar kernel
+/// evaluates one point at a time, a batch integrand as a batch of one. The
+/// vectorizable kernel transposes a batch of points to structure-of-arrays
+/// and calls a batch integrand once for all of them, or maps a point
+/// integrand over the batch, into a buffer. It reduces the buffer with
+/// independent lane accumulators that the compiler can keep in vector
+/// registers.
+template<size_t D, typename F>
+sums
+integrate_block(F& _f, const domain<D>& _dom, size_t _n, size_t _b,
+                uint64_t _seed, bool _simd) {
+  size_t begin = _b*sequential::BLOCK_SIZE;
+  size_t end = std::min(_n, begin + sequential::BLOCK_SIZE);
+  rng::philox4x32 generator = rng::stream<rng::philox4x32>(_seed, _b);
+
+  point<D> w;
+  for(size_t d = 0; d < D; ++d)
+    w[d] = _dom.hi[d] - _dom.lo[d];
+
+  static_assert(point_integrand<F, D> || batch_integrand<F, D>,
+                "Integrand must take a point or a batch of points");
+  constexpr bool batched = batch_integrand<F, D>;
+
+  // D doubles per point, and their transpose for a batch integrand, on the
+  // heap so that high dimensions do not overflow the stack of a worker thread
+  sums r;
+  std::vector<double> u(D*BATCH);
+  std::vector<double> x(batched && _simd ? D*BATCH : 0);
+  double vals[BATCH];
+  for(size_t i = begin; i < end; i += BATCH) {
+    size_t m = std::min(BATCH, end - i);
+    generator.fill(u.data(), D*m);
+
+    if(!_simd) {
+      for(size_t j = 0; j < m; ++j) {
+        point<D> p;
+        for(size_t d = 0; d < D; ++d)
+          p[d] = _dom.lo[d] + w[d]*u[j*D + d];
+        double v;
+        if constexpr(point_integrand<F, D>)
+          v = _f(p);
+        else
+          _f(static_cast<const double*>(p.data()), size_t(1), &v);
+        r.s += v;
+        r.s2 += v*v;
+      }
+      continue;
+    }
+
+    if constexpr(batched) {
+      for(size_t j = 0; j < m; ++j)
+        for(size_t d = 0; d < D; ++d)
+          x[d*m + j] = _dom.lo[d] + w[d]*u[j*D + d];
+      _f(static_cast<const double*>(x.data()), m, vals);
+    }
+    else
+      for(size_t j = 0; j < m; ++j) {
+        point<D> p;
+        for(size_t d = 0; d < D; ++d)
+          p[d] = _dom.lo[d] + w[d]*u[j*D + d];
+        vals[j] = _f(p);
+      }
+    constexpr size_t L = 8;
+    double s[L] = {}, s2[L] = {};
+    size_t j = 0;
+    for(; j + L <= m; j += L)
+      for(size_t l = 0; l < L; ++l) {
+        s[l] += vals[j + l];
+        s2[l] += vals[j + l]*vals[j + l];
+      }
+    for(; j < m; ++j) {
+      s[0] += vals[j];
+      s2[0] += vals[j]*vals[j];
+    }
+    for(size_t l = 0; l < L; ++l) {
+      r.s += s[l];
+      r.s2 += s2[l];
+    }
+  }
+  return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Indicator of the circle inscribed in the unit square, times 4
+////////////////////////////////////////////////////////////////////////////////
+struct circle_indicator {
+  /// @brief Value at one point
+  double operator()(const point<2>& _x) const {
+    return _x[0]*_x[0] + _x[1]*_x[1] < 0.25 ? 4. : 0.;
+  }
+
+  /// @brief Values at a batch of points, see batch_integrand
+  void operator()(const double* _x, size_t _m, double* _y) const {
+    const double* x0 = _x;
+    const double* x1 = _x + _m;
+    for(size_t j = 0; j < _m; ++j)
+      _y[j] = x0[j]*x0[j] + x1[j]*x1[j] < 0.25 ? 4. : 0.;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Combine per-block sums into an estimate
+/// @param _bs Per-block sums, in block order
+/// @param _n Number of samples, positive
+/// @param _volume Volume of the domain
+inline result
+finish(const std::vector<sums>& _bs, size_t _n, double _volume) {
+  double s = 0, s2 = 0;
+  for(const sums& b : _bs) {
+    s += b.s;
+    s2 += b.s2;
+  }
+  double mean = s/_n;
+  double var = std::max(0., s2/_n - mean*mean);
+  return result{_volume*mean, _volume*std::sqrt(var/_n), _n};
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Integrate on the calling thread
+/// @tparam D Dimension
+/// @tparam F Integrand, point_integrand or batch_integrand
+/// @param _f Integrand
+/// @param _dom Domain
+/// @param _n Number of samples
+/// @param _p Policy
+/// @param _seed Seed
+/// @return Estimate of the integral of @c _f over @c _dom
+///
+/// Throws std::invalid_argument without samples.
+template<size_t D, typename F>
+result
+mc_integrate(F&& _f, const domain<D>& _dom, size_t _n, sequential_policy _p,
+             uint64_t _seed = 0) {
+  if(_n == 0)
+    throw std::invalid_argument("Integration requires at least one sample.");
+  std::vector<detail::sums> bs(sequential::num_blocks(_n));
+  for(size_t b = 0; b < bs.size(); ++b)
+    bs[b] = detail::integrate_block(_f, _dom, _n, b, _seed, _p.simd);
+  return detail::finish(bs, _n, _dom.volume());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Integrate on a thread pool
+/// @tparam D Dimension
+/// @tparam F Integrand, point_integrand or batch_integrand, called
+///           concurrently
+/// @param _f Integrand
+/// @param _dom Domain
+/// @param _n Number of samples
+/// @param _p Policy
+/// @param _seed Seed
+/// @return Estimate, identical to the sequential policy with the same kernel
+///
+/// Throws std::invalid_argument without samples or without workers.
+template<size_t D, typename F>
+result
+mc_integrate(F&& _f, const domain<D>& _dom, size_t _n, pool_policy _p,
+             uint64_t _seed = 0) {
+  if(_n == 0)
+    throw std::invalid_argument("Integration requires at least one sample.");
+  if(_p.nt == 0)
+    throw std::invalid_argument("Pool policy requires at least one worker.");
+  std::vector<detail::sums> bs(sequential::num_blocks(_n));
+  std::atomic<size_t> next{0};
+
+  auto worker = [&]() {
+    for(size_t b = next++; b < bs.size(); b = next++)
+      bs[b] = detail::integrate_block(_f, _dom, _n, b, _seed, _p.simd);
+  };
+
+  std::vector<std::future<void>> fts;
+  fts.reserve(_p.nt);
+  for(size_t i = 0; i < _p.nt; ++i)
+    fts.emplace_back(_p.pool.submit(worker));
+  for(auto& ft : fts)
+    ft.get();
+
+  return detail::finish(bs, _n, _dom.volume());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi as 4 times the area of the circle inscribed in the
+///        unit square
+/// @tparam Policy Execution policy
+/// @param _n Number of samples
+/// @param _p Policy
+/// @param _seed Seed
+/// @return Estimate of pi
+template<typename Policy>
+result
+pi(size_t _n, Policy _p, uint64_t _seed = 0) {
+  return mc_integrate(detail::circle_indicator{},
+                      domain<2>{{-0.5, -0.5}, {0.5, 0.5}}, _n, _p, _seed);
+}
+
+}
@@ -0,0 +1,264 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Bounded lock-free multi-producer/multi-consumer queue.
+///
+/// The queue is Vyukov's ring of cells with sequence numbers. Cell i starts
+/// with sequence i. A producer owns position pos once it advanced the head
+/// from pos to pos + 1 while the sequence of cell pos%capacity was pos, and
+/// publishes its item by setting the sequence to pos + 1. A consumer takes
+/// position pos once the sequence is pos + 1 and frees the cell for the next
+/// lap by setting it to pos + capacity. Producers and consumers therefore only
+/// contend on their own index and on single cells, and the indices sit on
+/// separate cache lines.
+///
+/// The try_ operations claim a position with a compare-and-swap and fail
+/// instead of waiting. The blocking operations take a ticket with fetch_add
+/// and wait for their cell to reach the right sequence, which is fair and
+/// never spins on the shared index. They yield a few times before sleeping in
+/// std::atomic::wait, as the cell usually turns within a time slice and a
+/// futex sleep and wake per item would cost more than the queue itself.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Bounded MPMC queue
+/// @tparam T Item type, nothrow move constructible
+////////////////////////////////////////////////////////////////////////////////
+template<typename T>
+class mpmc_queue {
+  static_assert(std::is_nothrow_move_constructible_v<T>);
+
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors and special member functions
+    /// @{
+
+    /// @brief Construct an empty queue
+    /// @param _capacity Minimum capacity, rounded up to a power of two
+    explicit mpmc_queue(size_t _capacity) {
+      if(_capacity == 0)
+        throw std::invalid_argument("Queue capacity must be positive.");
+      m_capacity = std::bit_ceil(std::max<size_t>(_capacity, 2));
+      m_cells = std::make_unique<cell[]>(m_capacity);
+      for(size_t i = 0; i < m_capacity; ++i)
+        m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    mpmc_queue(const mpmc_queue&) = delete;
+    mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+    /// @brief Destroy the items still queued
+    ~mpmc_queue() {
+      for(size_t pos = m_tail.load(); ; ++pos) {
+        cell& c = m_cells[pos & (m_capacity - 1)];
+        if(c.seq.load() != pos + 1)
+          break;
+        c.take();
+      }
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    /// @brief Capacity
+    size_t capacity() const { return m_capacity; }
+
+    /// @brief Number of items, only a snapshot under concurrent use
+    size_t size() const {
+      size_t t = m_tail.load(std::memory_order_relaxed);
+      size_t h = m_head.load(std::memory_order_relaxed);
+      return h > t ? std::min(h - t, m_capacity) : 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Producers
+    /// @{
+
+    /// @brief Construct an item in place if there is room
+    /// @param _args Constructor arguments
+    /// @return Whether the item was queued
+    template<typename... Args>
+    bool try_emplace(Args&&... _args) {
+      size_t pos = m_head.load(std::memory_order_relaxed);
+      for(;;) {
+        cell& c = m_cells[pos & (m_capacity - 1)];
+        const size_t seq = c.seq.load(std::memory_order_acquire);
+        const ptrdiff_t diff = ptrdiff_t(seq - pos);
+        if(diff == 0) {
+          if(m_head.compare_exchange_weak(pos, pos + 1,
+                                          std::memory_order_relaxed)) {
+            c.construct(std::forward<Args>(_args)...);
+            c.publish(pos + 1);
+            return true;
+          }
+        }
+        else if(diff < 0)
+          return false;
+        else
+          pos = m_head.load(std::memory_order_relaxed);
+      }
+    }
+
+    /// @brief Queue an item if there is room
+    /// @param _x Item, moved from only on success
+    /// @return Whether the item was queued
+    bool try_push(T&& _x) { return try_emplace(std::move(_x)); }
+
+    /// @brief Queue a copy of an item if there is room
+    /// @param _x Item
+    /// @return Whether the item was queued
+    bool try_push(const T& _x) { return try_emplace(_x); }
+
+    /// @brief Construct an item in place, waiting for room
+    /// @param _args Constructor arguments
+    template<typename... Args>
+    void emplace(Args&&... _args) {
+      const size_t pos = m_head.fetch_add(1, std::memory_order_relaxed);
+      cell& c = m_cells[pos & (m_capacity - 1)];
+      c.wait_for(pos);
+      c.construct(std::forward<Args>(_args)...);
+      c.publish(pos + 1);
+    }
+
+    /// @brief Queue an item, waiting for room
+    /// @param _x Item
+    void push(T _x) { emplace(std::move(_x)); }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Consumers
+    /// @{
+
+    /// @brief Dequeue an item if there is one
+    /// @param _x Receives the item
+    /// @return Whether an item was dequeued
+    bool try_pop(T& _x) {
+      size_t pos = m_tail.load(std::memory_order_relaxed);
+      for(;;) {
+        cell& c = m_cells[pos & (m_capacity - 1)];
+        const size_t seq = c.seq.load(std::memory_order_acquire);
+        const ptrdiff_t diff = ptrdiff_t(seq - (pos + 1));
+        if(diff == 0) {
+          if(m_tail.compare_exchange_weak(pos, pos + 1,
+                                          std::memory_order_relaxed)) {
+            _x = c.take();
+            c.publish(pos + m_capacity);
+            return true;
+          }
+        }
+        else if(diff < 0)
+          return false;
+        else
+          pos = m_tail.load(std::memory_order_relaxed);
+      }
+    }
+
+    /// @brief Dequeue an item, waiting for one
+    /// @return Item
+    T pop() {
+      const size_t pos = m_tail.fetch_add(1, std::memory_order_relaxed);
+      cell& c = m_cells[pos & (m_capacity - 1)];
+      c.wait_for(pos + 1);
+      T x = c.take();
+      c.publish(pos + m_capacity);
+      return x;
+    }
+
+    /// @brief Dequeue up to a number of consecutive items at once
+    /// @tparam Out Output iterator
+    /// @param _out Receives the items in queue order
+    /// @param _max Maximum number of items
+    /// @return Number of items dequeued
+    ///
+    /// The run of ready items at the tail is claimed with a single
+    /// compare-and-swap, so a consumer pays the contended index once per batch.
+    template<typename Out>
+    size_t try_pop_bulk(Out _out, size_t _max) {
+      size_t pos = m_tail.load(std::memory_order_relaxed);
+      size_t k;
+      for(;;) {
+        k = 0;
+        while(k < _max && k < m_capacity &&
+              m_cells[(pos + k) & (m_capacity - 1)].seq.load(
+                std::memory_order_acquire) == pos + k + 1)
+          ++k;
+        if(k == 0)
+          return 0;
+        if(m_tail.compare_exchange_weak(pos, pos + k,
+                                        std::memory_order_relaxed))
+          break;
+      }
+      for(size_t i = 0; i < k; ++i) {
+        cell& c = m_cells[(pos + i) & (m_capacity - 1)];
+        *_out = c.take();
+        ++_out;
+        c.publish(pos + i + m_capacity);
+      }
+      return k;
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+  private:
+    static constexpr size_t SPINS = 16; ///< Yields before a blocking wait
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Slot of the ring
+    ////////////////////////////////////////////////////////////////////////////
+    struct cell {
+      std::atomic<size_t> seq;                  ///< Sequence number
+      alignas(T) unsigned char data[sizeof(T)]; ///< Item storage
+
+      /// @brief Construct the item
+      template<typename... Args>
+      void construct(Args&&... _args) {
+        ::new(static_cast<void*>(data)) T(std::forward<Args>(_args)...);
+      }
+
+      /// @brief Move the item out and destroy it
+      T take() {
+        T* p = std::launder(reinterpret_cast<T*>(data));
+        T x = std::move(*p);
+        p->~T();
+        return x;
+      }
+
+      /// @brief Hand the cell on and wake threads waiting for it
+      void publish(size_t _seq) {
+        seq.store(_seq, std::memory_order_release);
+        seq.notify_all();
+      }
+
+      /// @brief Wait for a sequence number
+      void wait_for(size_t _seq) {
+        for(size_t i = 0; i < SPINS; ++i) {
+          if(seq.load(std::memory_order_acquire) == _seq)
+            return;
+          std::this_thread::yield();
+        }
+        for(size_t s; (s = seq.load(std::memory_order_acquire)) != _seq;)
+          seq.wait(s, std::memory_order_acquire);
+      }
+    };
+
+    alignas(64) std::atomic<size_t> m_head{0}; ///< Next position to push
+    alignas(64) std::atomic<size_t> m_tail{0}; ///< Next position to pop
+    alignas(64) size_t m_capacity;             ///< Cells, a power of two
+    std::unique_ptr<cell[]> m_cells;           ///< Ring
+};
@@ -3,37 +3,67 @@
 /// @brief Parallel monte carlo approximation of pi.
 ////////////////////////////////////////////////////////////////////////////////
 
+#pragma once
+
+#include <algorithm>
 #include <atomic>
 #include <future>
+#include <memory>
 #include <random>
 #include <vector>
 
+#include "rng.h"
+#include "sequential_pi.h"
+#include "simd_sampling.h"
+#include "thread_pool.h"
+#include "work_stealing.h"
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Collection of parallel algorithms
 ////////////////////////////////////////////////////////////////////////////////
 namespace parallel {
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Count samples landing inside the circle for one task
+/// @tparam Engine Random number engine for the scalar sampler
+/// @param _n Number of samples.
+/// @param _i Task index, selects the random stream
+/// @param _s Sampling kernel
+/// @return Number of inner samples
+template<typename Engine>
+size_t
+count_inner(size_t _n, size_t _i, sampler _s) {
+  if(_s == sampler::simd)
+    return simd::count_inner(_n, 0, _i);
+  if(_s == sampler::integer)
+    return simd::count_inner_int(_n, 0, _i);
+
+  Engine generator = rng::stream<Engine>(0, _i);
+  return sequential::count_inner(generator, _n);
+}
+
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Approximate pi with monte carlo
+/// @tparam Engine Random number engine for the scalar sampler
 /// @param _n Number of samples.
 /// @param _nt Number of parallel threads
+/// @param _s Sampling kernel
 /// @return Approximation of pi
+template<typename Engine = std::default_random_engine>
 double
-pi(size_t _n, size_t _nt) {
+pi(size_t _n, size_t _nt, sampler _s = sampler::scalar) {
 
   std::atomic<size_t> n_inner_all{0}; // Total for all inner samples
 
-  auto f_ni = [&n_inner_all, _n = _n, _nt = _nt](size_t _i) {
-    std::default_random_engine generator{_i};
-    std::uniform_real_distribution<double> distribution(-0.5,0.5);
-    size_t n_inner = 0;
-    for(size_t i = 0; i < _n/_nt; ++i) {
-      double x = distribution(generator);
-      double y = distribution(generator);
-      if(x*x + y*y < 0.25)
-        ++n_inner;
-    }
-    n_inner_all += n_inner;
+  auto f_ni = [&n_inner_all, _n = _n, _nt = _nt, _s = _s](size_t _i) {
+    n_inner_all += detail::count_inner<Engine>(_n/_nt, _i, _s);
   };
 
   // Create all tasks for asyncronous execution. Destructors will wait for them
@@ -49,4 +79,166 @@ pi(size_t _n, size_t _nt) {
   return 4.f*n_inner_all/_n;
 }
 
-}
\ No newline at end of file
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi with monte carlo on an existing pool of threads
+/// @tparam Engine Random number engine for the scalar sampler
+/// @param _n Number of samples.
+/// @param _nt Number of tasks to split the samples into
+/// @param _pool Pool executing the tasks
+/// @param _s Sampling kernel
+/// @return Approximation of pi
+///
+/// Produces the same result as pi(_n, _nt, _s), but no threads are created.
+template<typename Engine = std::default_random_engine>
+double
+pi(size_t _n, size_t _nt, thread_pool& _pool, sampler _s = sampler::scalar) {
+  std::vector<std::future<size_t>> fts;
+  fts.reserve(_nt);
+
+  for(size_t i = 0; i < _nt; ++i)
+    fts.emplace_back(_pool.submit(detail::count_inner<Engine>, _n/_nt, i, _s));
+
+  size_t n_inner_all = 0;
+  for(auto& ft : fts)
+    n_inner_all += ft.get();
+
+  return 4.f*n_inner_all/_n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi with monte carlo, workers claiming chunks of samples
+/// @tparam Engine Random number engine for the scalar sampler
+/// @param _n Number of samples.
+/// @param _nt Number of workers
+/// @param _chunk Samples per claim
+/// @param _pool Pool executing the workers
+/// @param _s Sampling kernel
+/// @return Approximation of pi
+///
+/// Each worker draws from its own stream and claims chunks from a shared
+/// counter until none are left, so small chunks balance the load at the cost
+/// of more claims. With _chunk = n/nt every worker takes about one chunk, as
+/// in pi(_n, _nt, _pool).
+template<typename Engine = std::default_random_engine>
+double
+chunked_pi(size_t _n, size_t _nt, size_t _chunk, thread_pool& _pool,
+           sampler _s = sampler::scalar) {
+  _chunk = std::max<size_t>(1, _chunk);
+  const size_t nc = (_n + _chunk - 1)/_chunk;
+  std::atomic<size_t> next{0};
+
+  auto worker = [&next, nc, _n, _chunk, _s](size_t _i) {
+    auto len = [_n, _chunk](size_t _c) {
+      return std::min(_chunk, _n - _c*_chunk);
+    };
+    size_t n_inner = 0;
+    if(_s != sampler::scalar) {
+      simd::lanes st = simd::seed(0, _i);
+      const simd::isa isa = simd::best_isa();
+      for(size_t c = next++; c < nc; c = next++)
+        n_inner += _s == sampler::integer
+                   ? simd::count_inner_int(st, len(c), isa)
+                   : simd::count_inner(st, len(c), isa);
+    }
+    else {
+      Engine generator = rng::stream<Engine>(0, _i);
+      for(size_t c = next++; c < nc; c = next++)
+        n_inner += sequential::count_inner(generator, len(c));
+    }
+    return n_inner;
+  };
+
+  std::vector<std::future<size_t>> fts;
+  fts.reserve(_nt);
+  for(size_t i = 0; i < _nt; ++i)
+    fts.emplace_back(_pool.submit(worker, i));
+
+  size_t n_inner_all = 0;
+  for(auto& ft : fts)
+    n_inner_all += ft.get();
+
+  return 4.*n_inner_all/_n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi with monte carlo, independent of the thread count
+/// @param _n Number of samples.
+/// @param _nt Number of workers
+/// @param _pool Pool executing the workers
+/// @param _seed Seed
+/// @param _e Estimator
+/// @return Approximation of pi, bit-identical to sequential::reproducible_pi
+///
+/// Workers claim logical blocks (see sequential::count_block) from a shared
+/// counter until none are left, so every sample is drawn exactly once and the
+/// total count does not depend on how blocks were scheduled.
+inline double
+reproducible_pi(size_t _n, size_t _nt, thread_pool& _pool, uint64_t _seed = 0,
+                estimator _e = estimator::uniform) {
+  std::atomic<size_t> next{0};
+  const size_t nb = sequential::num_blocks(_n);
+
+  auto worker = [&next, nb, _n, _seed, _e]() {
+    size_t n_inner = 0;
+    for(size_t b = next++; b < nb; b = next++)
+      n_inner += sequential::count_block(_n, b, _seed, _e);
+    return n_inner;
+  };
+
+  std::vector<std::future<size_t>> fts;
+  fts.reserve(_nt);
+  for(size_t i = 0; i < _nt; ++i)
+    fts.emplace_back(_pool.submit(worker));
+
+  size_t n_inner_all = 0;
+  for(auto& ft : fts)
+    n_inner_all += ft.get();
+
+  return 4.*n_inner_all/_n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi with a chosen estimator on an existing pool
+/// @param _n Number of samples.
+/// @param _nt Number of workers
+/// @param _pool Pool executing the workers
+/// @param _e Estimator
+/// @return Approximation of pi, identical to sequential::pi(_n, _e)
+inline double
+pi(size_t _n, size_t _nt, thread_pool& _pool, estimator _e) {
+  return reproducible_pi(_n, _nt, _pool, 0, _e);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi with monte carlo on a work-stealing pool
+/// @param _n Number of samples.
+/// @param _pool Work-stealing pool, every logical block is one chunk task
+/// @param _seed Seed
+/// @param _e Estimator
+/// @return Approximation of pi, bit-identical to sequential::reproducible_pi
+inline double
+reproducible_pi(size_t _n, work_stealing_pool& _pool, uint64_t _seed = 0,
+                estimator _e = estimator::uniform) {
+  // Per-worker partial counts on separate cache lines, each allocated by its
+  // worker on its first chunk, so a pinned worker first-touches it on its
+  // NUMA node
+  struct alignas(64) padded_count { size_t n_inner{0}; };
+  std::vector<std::unique_ptr<padded_count>> counts(_pool.size());
+
+  _pool.parallel_for(sequential::num_blocks(_n),
+    [&counts, _n, _seed, _e](size_t _b, size_t _w) {
+      if(!counts[_w])
+        counts[_w] = std::make_unique<padded_count>();
+      counts[_w]->n_inner += sequential::count_block(_n, _b, _seed, _e);
+    }
+  );
+
+  size_t n_inner_all = 0;
+  for(auto& c : counts)
+    if(c)
+      n_inner_all += c->n_inner;
+
+  return 4.*n_inner_all/_n;
+}
+
+}
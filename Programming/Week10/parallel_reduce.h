@@ -0,0 +1,392 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Generic parallel reduction with compensated summation.
+///
+/// parallel::parallel_reduce splits a random access range into contiguous
+/// partitions, one per thread, but never shorter than detail::GRAIN elements,
+/// so small ranges stay on the calling thread. Each partition is folded with
+/// independent accumulators. For the commutative arithmetic operations
+/// (std::plus, std::multiplies, the bitwise ones) they take detail::LANES
+/// adjacent elements at a time in each of detail::STREAMS contiguous
+/// sub-blocks, so they pack into vector registers, as a single floating-point
+/// accumulator may not because addition is not associative, and the hardware
+/// prefetchers follow several streams. Any other operation need not be
+/// commutative, so detail::UNROLL accumulators fold one contiguous sub-block
+/// each, which only breaks up the dependency chain, and are combined in order.
+/// Either way a result depends on the range and the number of partitions only.
+///
+/// For floating-point sums (std::plus) the policies also select a summation:
+/// Kahan carries the exact rounding error of every addition (Knuth's TwoSum,
+/// an error independent of n), pairwise sums recursive halves (an error growing
+/// with log n) at almost the cost of the plain fold. Neither survives
+/// -ffast-math.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Summation algorithm of a reduction with std::plus
+////////////////////////////////////////////////////////////////////////////////
+enum class summation {
+  plain,   ///< Unrolled fold, also used by every operation but std::plus
+  kahan,   ///< Compensated, exact error of every addition carried along
+  pairwise ///< Recursive halving down to short unrolled blocks
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Collection of parallel algorithms
+////////////////////////////////////////////////////////////////////////////////
+namespace parallel {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Execution policies of parallel_reduce
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reduce on the calling thread
+////////////////////////////////////////////////////////////////////////////////
+struct sequential_policy {
+  summation mode{summation::plain}; ///< Summation of floating-point sums
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reduce partitions on std::async threads
+////////////////////////////////////////////////////////////////////////////////
+struct async_policy {
+  size_t nt{0};                     ///< Maximum threads, 0 for all hardware
+  summation mode{summation::plain}; ///< Summation of floating-point sums
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reduce partitions on a thread pool
+////////////////////////////////////////////////////////////////////////////////
+struct pool_policy {
+  thread_pool& pool;                ///< Pool, its size bounds the partitions
+  summation mode{summation::plain}; ///< Summation of floating-point sums
+};
+
+constexpr sequential_policy seq{}; ///< Sequential, plain summation
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Thread pool policy
+/// @param _pool Pool
+/// @param _mode Summation of floating-point sums
+inline pool_policy
+par(thread_pool& _pool, summation _mode = summation::plain) {
+  return pool_policy{_pool, _mode};
+}
+
+/// @}
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+constexpr size_t UNROLL = 8;                ///< Independent accumulators
+constexpr size_t STREAMS = 4;               ///< Sub-blocks, commutative fold
+constexpr size_t LANES = 4;                 ///< Lanes per sub-block
+constexpr size_t GRAIN = size_t(1) << 14;   ///< Minimum partition length
+constexpr size_t PAIRWISE_BLOCK = 128;      ///< Pairwise leaf length
+
+/// @brief Whether an operation is addition of T
+template<typename Op, typename T>
+constexpr bool is_plus = std::is_same_v<Op, std::plus<>> ||
+                         std::is_same_v<Op, std::plus<T>>;
+
+/// @brief Whether an operation on T is commutative, for the known ones
+template<typename Op, typename T>
+constexpr bool is_commutative =
+  (std::is_arithmetic_v<T> &&
+   (is_plus<Op, T> || std::is_same_v<Op, std::multiplies<>> ||
+    std::is_same_v<Op, std::multiplies<T>>)) ||
+  (std::is_integral_v<T> &&
+   (std::is_same_v<Op, std::bit_and<>> || std::is_same_v<Op, std::bit_or<>> ||
+    std::is_same_v<Op, std::bit_xor<>> || std::is_same_v<Op, std::bit_and<T>> ||
+    std::is_same_v<Op, std::bit_or<T>> || std::is_same_v<Op, std::bit_xor<T>>));
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Fold a range with independent accumulators
+/// @tparam T Value type
+/// @param _first First element
+/// @param _n Number of elements
+/// @param _init Initial value
+/// @param _op Associative operation
+/// @return _init op x_0 op ... op x_(n-1), in unspecified grouping, and in
+///         order unless the operation is commutative
+template<typename T, typename It, typename Op>
+T
+fold(It _first, size_t _n, T _init, Op& _op) {
+  if(_n < 2*UNROLL) {
+    for(size_t i = 0; i < _n; ++i)
+      _init = _op(std::move(_init), _first[i]);
+    return _init;
+  }
+
+  // Commutative: STREAMS contiguous sub-blocks read side by side, so the
+  // prefetchers follow several streams, each folded by LANES accumulators
+  // over adjacent elements, which the compiler packs into vector registers
+  if constexpr(is_commutative<Op, T>) {
+    constexpr size_t NA = STREAMS*LANES;
+    static_assert(NA <= 2*UNROLL, "Short ranges must take the loop above");
+    const size_t m = _n/NA*LANES;
+    auto at = [_first, m](size_t _k, size_t _j) {
+      return _first[_k/LANES*m + _j + _k%LANES];
+    };
+    auto acc = [&at]<size_t... K>(std::index_sequence<K...>) {
+      return std::array<T, NA>{T(at(K, 0))...};
+    }(std::make_index_sequence<NA>{});
+    for(size_t j = LANES; j < m; j += LANES)
+      [&]<size_t... K>(std::index_sequence<K...>) {
+        ((acc[K] = _op(acc[K], at(K, j))), ...);
+      }(std::make_index_sequence<NA>{});
+
+    for(const T& a : acc)
+      _init = _op(_init, a);
+    for(size_t i = STREAMS*m; i < _n; ++i)
+      _init = _op(_init, _first[i]);
+    return _init;
+  }
+
+  // Accumulator k folds the contiguous sub-block [k*m, (k + 1)*m), so the
+  // accumulators combined in index order keep the order of the operands
+  const size_t m = _n/UNROLL;
+  auto acc = [_first, m]<size_t... K>(std::index_sequence<K...>) {
+    return std::array<T, UNROLL>{T(_first[K*m])...};
+  }(std::make_index_sequence<UNROLL>{});
+
+  for(size_t j = 1; j < m; ++j)
+    for(size_t k = 0; k < UNROLL; ++k)
+      acc[k] = _op(std::move(acc[k]), _first[k*m + j]);
+
+  for(size_t k = 0; k < UNROLL; ++k)
+    _init = _op(std::move(_init), std::move(acc[k]));
+  for(size_t i = UNROLL*m; i < _n; ++i)
+    _init = _op(std::move(_init), _first[i]);
+  return _init;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Sum with its carried rounding error
+/// @tparam T Floating-point type
+////////////////////////////////////////////////////////////////////////////////
+template<std::floating_point T>
+struct compensated {
+  T s{0}; ///< Sum
+  T c{0}; ///< Accumulated rounding error, the value is s + c
+
+  /// @brief Add a value, keeping the exact error of the addition (TwoSum)
+  void add(T _x) {
+    T t = s + _x;
+    T z = t - s;
+    c += (s - (t - z)) + (_x - z);
+    s = t;
+  }
+
+  /// @brief Add another compensated sum
+  void add(const compensated& _o) {
+    add(_o.s);
+    c += _o.c;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Kahan summation of a range with UNROLL independent sums
+/// @tparam T Floating-point type
+/// @param _first First element
+/// @param _n Number of elements
+/// @return Compensated sum
+template<std::floating_point T, typename It>
+compensated<T>
+fold_kahan(It _first, size_t _n) {
+  std::array<compensated<T>, UNROLL> acc{};
+  size_t i = 0;
+  for(; i + UNROLL <= _n; i += UNROLL)
+    for(size_t k = 0; k < UNROLL; ++k)
+      acc[k].add(T(_first[i + k]));
+  for(; i < _n; ++i)
+    acc[0].add(T(_first[i]));
+
+  for(size_t k = 1; k < UNROLL; ++k)
+    acc[0].add(acc[k]);
+  return acc[0];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Pairwise fold of a non-empty range
+/// @tparam T Value type
+/// @param _first First element
+/// @param _n Number of elements, at least 1
+/// @param _op Associative operation
+/// @return x_0 op ... op x_(n-1)
+template<typename T, typename It, typename Op>
+T
+fold_pairwise(It _first, size_t _n, Op& _op) {
+  if(_n <= PAIRWISE_BLOCK)
+    return fold(_first + 1, _n - 1, T(_first[0]), _op);
+  const size_t h = _n/2;
+  return _op(fold_pairwise<T>(_first, h, _op),
+             fold_pairwise<T>(_first + h, _n - h, _op));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Maximum threads of a policy
+inline size_t
+max_threads(const sequential_policy&) {
+  return 1;
+}
+
+inline size_t
+max_threads(const async_policy& _p) {
+  return _p.nt ? _p.nt : std::max(1u, std::thread::hardware_concurrency());
+}
+
+inline size_t
+max_threads(const pool_policy& _p) {
+  return _p.pool.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Run a function for every partition under a policy
+/// @param _p Policy
+/// @param _np Number of partitions
+/// @param _f Function of the partition index, called concurrently
+/// @return Results in partition order
+template<typename F>
+auto
+run(const sequential_policy&, size_t _np, F&& _f) {
+  std::vector<std::invoke_result_t<F&, size_t>> rs;
+  rs.reserve(_np);
+  for(size_t i = 0; i < _np; ++i)
+    rs.push_back(_f(i));
+  return rs;
+}
+
+template<typename F>
+auto
+run(const async_policy&, size_t _np, F&& _f) {
+  using R = std::invoke_result_t<F&, size_t>;
+  std::vector<std::future<R>> fts;
+  fts.reserve(_np - 1);
+  for(size_t i = 1; i < _np; ++i)
+    fts.emplace_back(std::async(std::launch::async, std::ref(_f), i));
+
+  // The calling thread takes the first partition
+  std::vector<R> rs;
+  rs.reserve(_np);
+  rs.push_back(_f(0));
+  for(auto& ft : fts)
+    rs.push_back(ft.get());
+  return rs;
+}
+
+template<typename F>
+auto
+run(const pool_policy& _p, size_t _np, F&& _f) {
+  using R = std::invoke_result_t<F&, size_t>;
+  std::vector<std::future<R>> fts;
+  fts.reserve(_np);
+  for(size_t i = 0; i < _np; ++i)
+    fts.emplace_back(_p.pool.submit(std::ref(_f), i));
+
+  std::vector<R> rs;
+  rs.reserve(_np);
+  for(auto& ft : fts)
+    rs.push_back(ft.get());
+  return rs;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reduce a range in parallel
+/// @tparam It Random access iterator
+/// @tparam T Value type
+/// @tparam Op Associative operation, T(T, T) and T(T, value of It)
+/// @tparam Policy sequential_policy, async_policy, or pool_policy
+/// @param _first First element
+/// @param _last One past the last element
+/// @param _init Initial value, combined once
+/// @param _op Operation, called concurrently
+/// @param _p Policy
+/// @return Reduction of @c _init and all elements
+///
+/// Kahan and pairwise summation apply to floating-point T with std::plus,
+/// integral sums are exact and always use the plain fold. Any other operation
+/// with them throws std::invalid_argument.
+template<std::random_access_iterator It, typename T, typename Op,
+         typename Policy>
+T
+parallel_reduce(It _first, It _last, T _init, Op _op, Policy _p) {
+  if(_p.mode != summation::plain && !detail::is_plus<Op, T>)
+    throw std::invalid_argument("Compensated summation requires std::plus.");
+
+  const size_t n = std::distance(_first, _last);
+  if(n == 0)
+    return _init;
+  const size_t np =
+    std::clamp<size_t>(n/detail::GRAIN, 1, detail::max_threads(_p));
+  auto begin = [n, np](size_t _i) { return n*_i/np; };
+
+  if constexpr(std::floating_point<T> && detail::is_plus<Op, T>) {
+    if(_p.mode == summation::kahan) {
+      auto ps = detail::run(_p, np, [&](size_t _i) {
+        return detail::fold_kahan<T>(_first + begin(_i),
+                                     begin(_i + 1) - begin(_i));
+      });
+      detail::compensated<T> sum;
+      sum.add(_init);
+      for(const auto& p : ps)
+        sum.add(p);
+      return sum.s + sum.c;
+    }
+    if(_p.mode == summation::pairwise) {
+      auto ps = detail::run(_p, np, [&](size_t _i) {
+        return detail::fold_pairwise<T>(_first + begin(_i),
+                                        begin(_i + 1) - begin(_i), _op);
+      });
+      return _op(_init, detail::fold_pairwise<T>(ps.begin(), np, _op));
+    }
+  }
+
+  auto ps = detail::run(_p, np, [&](size_t _i) {
+    It f = _first + begin(_i);
+    return detail::fold(f + 1, begin(_i + 1) - begin(_i) - 1, T(*f), _op);
+  });
+  for(auto& p : ps)
+    _init = _op(std::move(_init), std::move(p));
+  return _init;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Sum a range in parallel
+/// @tparam It Random access iterator
+/// @tparam T Value type
+/// @tparam Policy sequential_policy, async_policy, or pool_policy
+/// @param _first First element
+/// @param _last One past the last element
+/// @param _init Initial value
+/// @param _p Policy, selects the summation
+/// @return Sum of @c _init and all elements
+template<std::random_access_iterator It, typename T, typename Policy>
+T
+parallel_reduce(It _first, It _last, T _init, Policy _p) {
+  return parallel_reduce(_first, _last, std::move(_init), std::plus<>(), _p);
+}
+
+}
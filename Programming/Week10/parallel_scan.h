@@ -0,0 +1,352 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Block-parallel inclusive and exclusive scans (prefix sums).
+///
+/// The scans split a range into the same partitions as parallel_reduce and take
+/// two passes over it. The first reduces every partition independently, the
+/// calling thread scans the few partition totals into carries, and the second
+/// scans every partition again, starting from its carry. Both passes read the
+/// input in order, so the output may alias the input.
+///
+/// Sums (std::plus) of doubles and of 32-bit and 64-bit integers in contiguous
+/// memory are scanned in AVX2 registers where the CPU supports it: a log-step
+/// scan inside a register (shift by one lane and add, then by two, then by
+/// four) plus the broadcast carry of the previous register. This replaces the
+/// serial chain of one dependent addition per element by one per register.
+/// Floating-point sums are grouped differently than by a sequential scan, so
+/// they may differ from std::inclusive_scan in the last bits.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cpu_isa.h"
+#include "parallel_reduce.h"
+
+namespace parallel {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+#ifdef CPU_ISA_X86
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief AVX2 sum scan of doubles
+/// @tparam Inclusive Whether element i is part of output i
+/// @param _x Input
+/// @param _n Number of elements
+/// @param _y Output, may equal @c _x
+/// @param _carry Sum of everything before @c _x
+/// @return Sum of @c _carry and all elements
+template<bool Inclusive>
+__attribute__((target("avx2")))
+double
+scan_avx2(const double* _x, size_t _n, double* _y, double _carry) {
+  const __m256d zero = _mm256_setzero_pd();
+  __m256d c = _mm256_set1_pd(_carry);
+  size_t i = 0;
+  for(; i + 4 <= _n; i += 4) {
+    __m256d x = _mm256_loadu_pd(_x + i);
+    __m256d s = _mm256_add_pd(x, _mm256_blend_pd(
+      _mm256_permute4x64_pd(x, 0x93), zero, 0x1));
+    s = _mm256_add_pd(s, _mm256_permute2f128_pd(s, s, 0x08));
+    __m256d e = Inclusive ? s : _mm256_blend_pd(
+      _mm256_permute4x64_pd(s, 0x93), zero, 0x1);
+    _mm256_storeu_pd(_y + i, _mm256_add_pd(c, e));
+    c = _mm256_add_pd(c, _mm256_permute4x64_pd(s, 0xFF));
+  }
+  _carry = _mm256_cvtsd_f64(c);
+  for(; i < _n; ++i) {
+    double x = _x[i];
+    _y[i] = Inclusive ? _carry + x : _carry;
+    _carry += x;
+  }
+  return _carry;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief AVX2 sum scan of 64-bit integers, wrapping on overflow
+/// @tparam Inclusive Whether element i is part of output i
+/// @param _x Input
+/// @param _n Number of elements
+/// @param _y Output, may equal @c _x
+/// @param _carry Sum of everything before @c _x
+/// @return Sum of @c _carry and all elements
+template<bool Inclusive>
+__attribute__((target("avx2")))
+uint64_t
+scan_avx2(const uint64_t* _x, size_t _n, uint64_t* _y, uint64_t _carry) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i c = _mm256_set1_epi64x(int64_t(_carry));
+  size_t i = 0;
+  for(; i + 4 <= _n; i += 4) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_x + i));
+    __m256i s = _mm256_add_epi64(x, _mm256_blend_epi32(
+      _mm256_permute4x64_epi64(x, 0x93), zero, 0x03));
+    s = _mm256_add_epi64(s, _mm256_permute2x128_si256(s, s, 0x08));
+    __m256i e = Inclusive ? s : _mm256_blend_epi32(
+      _mm256_permute4x64_epi64(s, 0x93), zero, 0x03);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_y + i),
+                        _mm256_add_epi64(c, e));
+    c = _mm256_add_epi64(c, _mm256_permute4x64_epi64(s, 0xFF));
+  }
+  _carry = uint64_t(_mm256_extract_epi64(c, 0));
+  for(; i < _n; ++i) {
+    uint64_t x = _x[i];
+    _y[i] = Inclusive ? _carry + x : _carry;
+    _carry += x;
+  }
+  return _carry;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief AVX2 sum scan of 32-bit integers, wrapping on overflow
+/// @tparam Inclusive Whether element i is part of output i
+/// @param _x Input
+/// @param _n Number of elements
+/// @param _y Output, may equal @c _x
+/// @param _carry Sum of everything before @c _x
+/// @return Sum of @c _carry and all elements
+template<bool Inclusive>
+__attribute__((target("avx2")))
+uint32_t
+scan_avx2(const uint32_t* _x, size_t _n, uint32_t* _y, uint32_t _carry) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i by1 = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+  const __m256i by2 = _mm256_setr_epi32(6, 7, 0, 1, 2, 3, 4, 5);
+  const __m256i last = _mm256_set1_epi32(7);
+  __m256i c = _mm256_set1_epi32(int32_t(_carry));
+  size_t i = 0;
+  for(; i + 8 <= _n; i += 8) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_x + i));
+    __m256i s = _mm256_add_epi32(x, _mm256_blend_epi32(
+      _mm256_permutevar8x32_epi32(x, by1), zero, 0x01));
+    s = _mm256_add_epi32(s, _mm256_blend_epi32(
+      _mm256_permutevar8x32_epi32(s, by2), zero, 0x03));
+    s = _mm256_add_epi32(s, _mm256_permute2x128_si256(s, s, 0x08));
+    __m256i e = Inclusive ? s : _mm256_blend_epi32(
+      _mm256_permutevar8x32_epi32(s, by1), zero, 0x01);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_y + i),
+                        _mm256_add_epi32(c, e));
+    c = _mm256_add_epi32(c, _mm256_permutevar8x32_epi32(s, last));
+  }
+  _carry = uint32_t(_mm256_cvtsi256_si32(c));
+  for(; i < _n; ++i) {
+    uint32_t x = _x[i];
+    _y[i] = Inclusive ? _carry + x : _carry;
+    _carry += x;
+  }
+  return _carry;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Unsigned type of the same width for the AVX2 integer kernels
+template<typename T>
+using kernel_t = typename std::conditional_t<std::floating_point<T>,
+                                             std::type_identity<T>,
+                                             std::make_unsigned<T>>::type;
+
+/// @brief Whether a scan has an AVX2 kernel
+template<typename T, typename It, typename Out, typename Op>
+constexpr bool has_simd_scan = []() {
+  if constexpr(!is_plus<Op, T> || !std::contiguous_iterator<It> ||
+               !std::contiguous_iterator<Out>)
+    return false;
+  else if constexpr(!std::is_same_v<std::iter_value_t<It>, T> ||
+                    !std::is_same_v<std::iter_value_t<Out>, T>)
+    return false;
+  else
+    return std::is_same_v<T, double> ||
+           (std::integral<T> && !std::is_same_v<T, bool> &&
+            (sizeof(T) == 4 || sizeof(T) == 8));
+}();
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Scan a block starting from a carry
+/// @tparam Inclusive Whether element i is part of output i
+/// @param _x Input
+/// @param _n Number of elements
+/// @param _y Output, may equal @c _x
+/// @param _carry Reduction of everything before @c _x
+/// @param _op Associative operation
+/// @return Reduction of @c _carry and all elements
+template<bool Inclusive, typename T, typename It, typename Out, typename Op>
+T
+scan_block(It _x, size_t _n, Out _y, T _carry, Op& _op) {
+#ifdef CPU_ISA_X86
+  if constexpr(has_simd_scan<T, It, Out, Op>) {
+    if(simd::best_isa() >= simd::isa::avx2) {
+      using K = kernel_t<T>;
+      return T(scan_avx2<Inclusive>(
+        reinterpret_cast<const K*>(std::to_address(_x)), _n,
+        reinterpret_cast<K*>(std::to_address(_y)), K(_carry)));
+    }
+  }
+#endif
+  for(size_t i = 0; i < _n; ++i) {
+    T x = _x[i];
+    if constexpr(Inclusive) {
+      _carry = _op(std::move(_carry), std::move(x));
+      _y[i] = _carry;
+    }
+    else {
+      _y[i] = _carry;
+      _carry = _op(std::move(_carry), std::move(x));
+    }
+  }
+  return _carry;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Two-pass block-parallel scan
+/// @tparam Inclusive Whether element i is part of output i
+/// @param _first First element
+/// @param _n Number of elements
+/// @param _d_first First output
+/// @param _init Initial value, nullptr to start inclusive scans at element 0
+/// @param _op Associative operation, called concurrently
+/// @param _p Policy
+template<bool Inclusive, typename T, typename It, typename Out, typename Op,
+         typename Policy>
+void
+scan(It _first, size_t _n, Out _d_first, const T* _init, Op& _op,
+     const Policy& _p) {
+  if(_n == 0)
+    return;
+  const size_t np = std::clamp<size_t>(_n/GRAIN, 1, max_threads(_p));
+  auto begin = [_n, np](size_t _i) { return _n*_i/np; };
+
+  // Totals of all partitions but the last, carries[i] ends partition i
+  std::vector<T> carries;
+  if(np > 1)
+    carries = run(_p, np - 1, [&](size_t _i) {
+      It f = _first + begin(_i);
+      return fold(f + 1, begin(_i + 1) - begin(_i) - 1, T(*f), _op);
+    });
+  if(np > 1 && _init)
+    carries[0] = _op(*_init, std::move(carries[0]));
+  for(size_t i = 1; i + 1 < np; ++i)
+    carries[i] = _op(carries[i - 1], std::move(carries[i]));
+
+  run(_p, np, [&](size_t _i) {
+    size_t b = begin(_i);
+    size_t e = begin(_i + 1);
+    if(_i > 0 || _init) {
+      scan_block<Inclusive>(_first + b, e - b, _d_first + b,
+                            _i > 0 ? carries[_i - 1] : *_init, _op);
+      return 0;
+    }
+    // Inclusive scan without initial value, element 0 starts the carry
+    T x = *_first;
+    *_d_first = x;
+    scan_block<Inclusive>(_first + 1, e - 1, _d_first + 1, std::move(x), _op);
+    return 0;
+  });
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Inclusive scan of a range in parallel
+/// @tparam It Random access iterator
+/// @tparam Out Random access iterator
+/// @tparam Op Associative operation, T(T, T) for the value type T of It
+/// @tparam Policy sequential_policy, async_policy, or pool_policy
+/// @param _first First element
+/// @param _last One past the last element
+/// @param _d_first First output, may equal @c _first
+/// @param _op Operation, called concurrently
+/// @param _p Policy, its summation mode is ignored
+/// @return One past the last output
+///
+/// Output i is x_0 op ... op x_i, as for std::inclusive_scan.
+template<std::random_access_iterator It, std::random_access_iterator Out,
+         typename Op, typename Policy>
+Out
+parallel_inclusive_scan(It _first, It _last, Out _d_first, Op _op,
+                        Policy _p) {
+  using T = std::iter_value_t<It>;
+  const size_t n = std::distance(_first, _last);
+  detail::scan<true>(_first, n, _d_first, static_cast<const T*>(nullptr), _op,
+                     _p);
+  return _d_first + n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Inclusive prefix sum of a range in parallel
+/// @tparam It Random access iterator
+/// @tparam Out Random access iterator
+/// @tparam Policy sequential_policy, async_policy, or pool_policy
+/// @param _first First element
+/// @param _last One past the last element
+/// @param _d_first First output, may equal @c _first
+/// @param _p Policy
+/// @return One past the last output
+template<std::random_access_iterator It, std::random_access_iterator Out,
+         typename Policy>
+Out
+parallel_inclusive_scan(It _first, It _last, Out _d_first, Policy _p) {
+  return parallel_inclusive_scan(_first, _last, _d_first, std::plus<>(), _p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Exclusive scan of a range in parallel
+/// @tparam It Random access iterator
+/// @tparam Out Random access iterator
+/// @tparam T Value type
+/// @tparam Op Associative operation, T(T, T) and T(T, value of It)
+/// @tparam Policy sequential_policy, async_policy, or pool_policy
+/// @param _first First element
+/// @param _last One past the last element
+/// @param _d_first First output, may equal @c _first
+/// @param _init Initial value, output 0
+/// @param _op Operation, called concurrently
+/// @param _p Policy, its summation mode is ignored
+/// @return One past the last output
+///
+/// Output i is init op x_0 op ... op x_(i-1), as for std::exclusive_scan.
+template<std::random_access_iterator It, std::random_access_iterator Out,
+         typename T, typename Op, typename Policy>
+Out
+parallel_exclusive_scan(It _first, It _last, Out _d_first, T _init, Op _op,
+                        Policy _p) {
+  const size_t n = std::distance(_first, _last);
+  detail::scan<false>(_first, n, _d_first, &_init, _op, _p);
+  return _d_first + n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Exclusive prefix sum of a range in parallel
+/// @tparam It Random access iterator
+/// @tparam Out Random access iterator
+/// @tparam T Value type
+/// @tparam Policy sequential_policy, async_policy, or pool_policy
+/// @param _first First element
+/// @param _last One past the last element
+/// @param _d_first First output, may equal @c _first
+/// @param _init Initial value, output 0
+/// @param _p Policy
+/// @return One past the last output
+template<std::random_access_iterator It, std::random_access_iterator Out,
+         typename T, typename Policy>
+Out
+parallel_exclusive_scan(It _first, It _last, Out _d_first, T _init,
+                        Policy _p) {
+  return parallel_exclusive_scan(_first, _last, _d_first, std::move(_init),
+                                 std::plus<>(), _p);
+}
+
+}
@@ -0,0 +1,271 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Hardware performance counters around a region of code (Linux).
+///
+/// Every event is opened with perf_event_open once per thread of interest,
+/// user space only, so the hardware events work with the default
+/// perf_event_paranoid setting.
+/// Counters opened on the calling thread inherit to threads it creates later,
+/// which covers std::async; pool workers already exist and are attached by
+/// thread id. Events the kernel, the hardware, or a container refuse on any of
+/// these threads, or that cannot be read back from all of them, are reported
+/// as unavailable instead of failing or undercounting.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "affinity.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Performance counters
+////////////////////////////////////////////////////////////////////////////////
+namespace perf {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Counted events
+////////////////////////////////////////////////////////////////////////////////
+enum class event {
+  cycles,          ///< CPU cycles
+  instructions,    ///< Retired instructions
+  branch_misses,   ///< Mispredicted branches
+  l1d_misses,      ///< L1 data cache read misses
+  llc_misses,      ///< Last level cache misses
+  context_switches ///< Context switches (software event)
+};
+
+constexpr size_t NUM_EVENTS = 6; ///< Number of events
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Name of an event
+inline const char*
+name(event _e) {
+  switch(_e) {
+    case event::cycles:        return "cycles";
+    case event::instructions:  return "instructions";
+    case event::branch_misses: return "branch-misses";
+    case event::l1d_misses:    return "L1d-misses";
+    case event::llc_misses:    return "LLC-misses";
+    default:                   return "context-switches";
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Counter values of one measurement
+////////////////////////////////////////////////////////////////////////////////
+struct sample {
+  std::array<double, NUM_EVENTS> value{}; ///< Counts, scaled if multiplexed
+  std::array<bool, NUM_EVENTS> valid{};   ///< Event counted on all threads
+
+  /// @brief Count of an event
+  double operator[](event _e) const { return value[size_t(_e)]; }
+
+  /// @brief Whether an event was counted
+  bool has(event _e) const { return valid[size_t(_e)]; }
+
+  /// @brief Instructions per cycle, NaN if not available
+  double ipc() const {
+    double c = (*this)[event::cycles];
+    return has(event::cycles) && has(event::instructions) && c > 0
+      ? (*this)[event::instructions]/c : NAN;
+  }
+
+  /// @brief Count of an event per unit of work, NaN if not available
+  /// @param _e Event
+  /// @param _n Units of work, e.g., samples drawn
+  double per(event _e, double _n) const {
+    return has(_e) && _n > 0 ? (*this)[_e]/_n : NAN;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief All events, attached to a set of threads
+////////////////////////////////////////////////////////////////////////////////
+class counters {
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors and special member functions
+    /// @{
+
+    /// @brief Open the events
+    /// @param _tids Threads to count in addition to the calling thread
+    explicit counters(const std::vector<int>& _tids = {}) {
+      std::vector<int> tids{0};
+      for(int t : _tids)
+        if(t != 0 && t != affinity::thread_id())
+          tids.push_back(t);
+      // An event missing on some threads would undercount, drop it entirely
+      for(size_t e = 0; e < NUM_EVENTS; ++e)
+        for(int t : tids) {
+          int fd = open(event(e), t, t == 0);
+          if(fd < 0) {
+            close_all(m_fds[e]);
+            break;
+          }
+          m_fds[e].push_back(fd);
+        }
+    }
+
+    /// @brief Destructor, closes the events
+    ~counters() {
+      for(auto& fds : m_fds)
+        close_all(fds);
+    }
+
+    /// @brief Copy constructor
+    counters(const counters&) = delete;
+    /// @brief Move constructor
+    counters(counters&&) = delete;
+    /// @brief Copy assignment
+    counters& operator=(const counters&) = delete;
+    /// @brief Move assignment
+    counters& operator=(counters&&) = delete;
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Whether any event could be opened on all threads
+    bool available() const {
+      for(auto& fds : m_fds)
+        if(!fds.empty())
+          return true;
+      return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Reset and start counting
+    void start() {
+#ifdef __linux__
+      for(auto& fds : m_fds)
+        for(int fd : fds)
+          ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      for(auto& fds : m_fds)
+        for(int fd : fds)
+          ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Stop counting
+    /// @return Counts since start(), summed over threads, an event is valid
+    ///         only if it was read back from every thread
+    sample stop() {
+      sample s;
+#ifdef __linux__
+      for(auto& fds : m_fds)
+        for(int fd : fds)
+          ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      for(size_t e = 0; e < NUM_EVENTS; ++e) {
+        s.valid[e] = !m_fds[e].empty();
+        for(int fd : m_fds[e]) {
+          // value, time enabled, time running
+          uint64_t r[3];
+          if(read(fd, r, sizeof(r)) != sizeof(r)) {
+            s.valid[e] = false;
+            continue;
+          }
+          // Scale up if the event was multiplexed with others
+          s.value[e] += r[2] == 0 ? 0. : double(r[0])*r[1]/r[2];
+        }
+      }
+#endif
+      return s;
+    }
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Close the descriptors of one event
+    /// @param _fds Descriptors, empty afterwards
+    static void close_all(std::vector<int>& _fds) {
+#ifdef __linux__
+      for(int fd : _fds)
+        close(fd);
+#endif
+      _fds.clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Open one event, disabled
+    /// @param _e Event
+    /// @param _tid Thread id, 0 for the calling thread
+    /// @param _inherit Count threads created later by this thread as well
+    /// @return File descriptor, negative on failure
+    static int open(event _e, int _tid, bool _inherit) {
+#ifdef __linux__
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      switch(_e) {
+        case event::cycles:
+          attr.config = PERF_COUNT_HW_CPU_CYCLES;
+          break;
+        case event::instructions:
+          attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+          break;
+        case event::branch_misses:
+          attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+          break;
+        case event::l1d_misses:
+          attr.type = PERF_TYPE_HW_CACHE;
+          attr.config = PERF_COUNT_HW_CACHE_L1D |
+                        PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                        PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+          break;
+        case event::llc_misses:
+          attr.config = PERF_COUNT_HW_CACHE_MISSES;
+          break;
+        case event::context_switches:
+          attr.type = PERF_TYPE_SOFTWARE;
+          attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+          break;
+      }
+      attr.disabled = 1;
+      attr.inherit = _inherit;
+      // Context switches happen in the kernel, counting them in user space
+      // only always gives 0, so that event needs perf_event_paranoid <= 1.
+      attr.exclude_kernel = _e != event::context_switches;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      return int(syscall(SYS_perf_event_open, &attr, _tid, -1, -1, 0));
+#else
+      (void)_e;
+      (void)_tid;
+      (void)_inherit;
+      return -1;
+#endif
+    }
+
+    std::array<std::vector<int>, NUM_EVENTS> m_fds; ///< Descriptors per event
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Count events while running a function
+/// @tparam F Callable
+/// @param _tids Threads to count in addition to the calling thread
+/// @param _f Callable
+/// @return Counts
+template<typename F>
+sample
+measure(const std::vector<int>& _tids, F&& _f) {
+  counters c(_tids);
+  c.start();
+  _f();
+  return c.stop();
+}
+
+}
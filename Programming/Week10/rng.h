@@ -0,0 +1,283 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Fast random number engines with independent parallel streams.
+///
+/// All engines satisfy UniformRandomBitGenerator, so they work with the
+/// standard distributions, and additionally provide a bulk fill of uniform
+/// doubles. Use stream() to give every thread or task its own engine.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Random number engines
+////////////////////////////////////////////////////////////////////////////////
+namespace rng {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Map 64 random bits to a double in [0, 1)
+/// @param _x Random bits
+/// @return Uniform double with 53 random bits
+constexpr double
+to_unit(uint64_t _x) {
+  return (_x >> 11) * 0x1.0p-53;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Splitmix64, a tiny engine mostly used to expand seeds
+////////////////////////////////////////////////////////////////////////////////
+class splitmix64 {
+  public:
+    using result_type = uint64_t; ///< Output type
+
+    /// @brief Construct from seed
+    /// @param _seed Seed
+    explicit splitmix64(uint64_t _seed = 0) : m_x{_seed} {}
+
+    /// @brief Smallest output
+    static constexpr result_type min() { return 0; }
+    /// @brief Largest output
+    static constexpr result_type max() {
+      return std::numeric_limits<result_type>::max();
+    }
+
+    /// @brief Next output
+    result_type operator()() {
+      uint64_t z = (m_x += 0x9E3779B97F4A7C15ull);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      return z ^ (z >> 31);
+    }
+
+  private:
+    uint64_t m_x; ///< State
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Xoshiro256++ engine (Blackman and Vigna).
+///
+/// Period 2^256 - 1. jump() advances 2^128 steps and long_jump() 2^192 steps,
+/// which splits the period into non-overlapping streams.
+////////////////////////////////////////////////////////////////////////////////
+class xoshiro256pp {
+  public:
+    using result_type = uint64_t; ///< Output type
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors
+    /// @{
+
+    /// @brief Construct from seed, expanded with splitmix64
+    /// @param _seed Seed
+    explicit xoshiro256pp(uint64_t _seed = 0) {
+      splitmix64 sm{_seed};
+      for(auto& s : m_s)
+        s = sm();
+    }
+    /// @brief Construct from full state, must not be all zero
+    /// @param _s State
+    explicit xoshiro256pp(const std::array<uint64_t, 4>& _s) : m_s{_s} {}
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    /// @brief Smallest output
+    static constexpr result_type min() { return 0; }
+    /// @brief Largest output
+    static constexpr result_type max() {
+      return std::numeric_limits<result_type>::max();
+    }
+
+    /// @brief Next output
+    result_type operator()() {
+      uint64_t r = rotl(m_s[0] + m_s[3], 23) + m_s[0];
+      uint64_t t = m_s[1] << 17;
+      m_s[2] ^= m_s[0];
+      m_s[3] ^= m_s[1];
+      m_s[1] ^= m_s[2];
+      m_s[0] ^= m_s[3];
+      m_s[2] ^= t;
+      m_s[3] = rotl(m_s[3], 45);
+      return r;
+    }
+
+    /// @brief Advance 2^128 steps
+    void jump() {
+      jump({0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull,
+            0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull});
+    }
+    /// @brief Advance 2^192 steps
+    void long_jump() {
+      jump({0x76E15D3EFEFDCBBFull, 0xC5004E441C522FB3ull,
+            0x77710069854EE241ull, 0x39109BB02ACBE635ull});
+    }
+
+    /// @brief Fill with uniform doubles
+    /// @param _d Output
+    /// @param _n Number of doubles
+    /// @param _a Lower bound
+    /// @param _b Upper bound (exclusive)
+    void fill(double* _d, size_t _n, double _a = 0., double _b = 1.) {
+      const double w = _b - _a;
+      for(size_t i = 0; i < _n; ++i)
+        _d[i] = _a + w*to_unit((*this)());
+    }
+
+    /// @brief Full state
+    const std::array<uint64_t, 4>& state() const { return m_s; }
+
+  private:
+    /// @brief Rotate left
+    static constexpr uint64_t rotl(uint64_t _x, int _k) {
+      return (_x << _k) | (_x >> (64 - _k));
+    }
+
+    /// @brief Jump by a polynomial
+    /// @param _poly Jump polynomial
+    void jump(const std::array<uint64_t, 4>& _poly) {
+      std::array<uint64_t, 4> s{0, 0, 0, 0};
+      for(uint64_t p : _poly)
+        for(int b = 0; b < 64; ++b) {
+          if(p & (uint64_t(1) << b))
+            for(size_t k = 0; k < 4; ++k)
+              s[k] ^= m_s[k];
+          (*this)();
+        }
+      m_s = s;
+    }
+
+    std::array<uint64_t, 4> m_s; ///< State
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Philox4x32-10 counter-based engine (Salmon et al.).
+///
+/// Output block c is a pure function of (key, c), so any position of any
+/// stream is reachable in O(1). The key is the seed, the upper 64 bits of the
+/// 128-bit counter select the stream and the lower 64 bits count blocks.
+////////////////////////////////////////////////////////////////////////////////
+class philox4x32 {
+  public:
+    using result_type = uint32_t;               ///< Output type
+    using block_type = std::array<uint32_t, 4>; ///< Counter/output block
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Construct from seed and stream
+    /// @param _seed Seed, used as key
+    /// @param _stream Stream index
+    explicit philox4x32(uint64_t _seed = 0, uint64_t _stream = 0) :
+      m_key{uint32_t(_seed), uint32_t(_seed >> 32)},
+      m_stream{_stream} {}
+
+    /// @brief Smallest output
+    static constexpr result_type min() { return 0; }
+    /// @brief Largest output
+    static constexpr result_type max() {
+      return std::numeric_limits<result_type>::max();
+    }
+
+    /// @brief Next output
+    result_type operator()() {
+      if(m_i == 4) {
+        m_out = generate(m_block++);
+        m_i = 0;
+      }
+      return m_out[m_i++];
+    }
+
+    /// @brief Skip outputs
+    /// @param _z Number of outputs to skip
+    void discard(unsigned long long _z) {
+      uint64_t pos = 4*m_block - (4 - m_i) + _z;
+      m_block = pos/4;
+      m_i = 4;
+      for(uint64_t r = pos%4; r > 0; --r)
+        (*this)();
+    }
+
+    /// @brief Fill with uniform doubles, two outputs per double
+    /// @param _d Output
+    /// @param _n Number of doubles
+    /// @param _a Lower bound
+    /// @param _b Upper bound (exclusive)
+    void fill(double* _d, size_t _n, double _a = 0., double _b = 1.) {
+      const double w = _b - _a;
+      size_t i = 0;
+      // Whole blocks straight from the counter
+      if(m_i == 4) {
+        for(; i + 2 <= _n; i += 2) {
+          block_type o = generate(m_block++);
+          _d[i]   = _a + w*to_unit(uint64_t(o[0]) << 32 | o[1]);
+          _d[i+1] = _a + w*to_unit(uint64_t(o[2]) << 32 | o[3]);
+        }
+      }
+      for(; i < _n; ++i) {
+        uint64_t hi = (*this)();
+        _d[i] = _a + w*to_unit(hi << 32 | (*this)());
+      }
+    }
+
+    /// @brief Output block of the current stream
+    /// @param _c Block index
+    /// @return Four random words
+    block_type generate(uint64_t _c) const {
+      return bijection({uint32_t(_c), uint32_t(_c >> 32),
+                        uint32_t(m_stream), uint32_t(m_stream >> 32)}, m_key);
+    }
+
+    /// @brief Philox4x32-10 bijection
+    /// @param _c Counter
+    /// @param _k Key
+    /// @return Four random words
+    static block_type bijection(block_type _c, std::array<uint32_t, 2> _k) {
+      for(int r = 0; r < 10; ++r) {
+        uint64_t p0 = uint64_t(0xD2511F53u)*_c[0];
+        uint64_t p1 = uint64_t(0xCD9E8D57u)*_c[2];
+        _c = {uint32_t(p1 >> 32) ^ _c[1] ^ _k[0], uint32_t(p1),
+              uint32_t(p0 >> 32) ^ _c[3] ^ _k[1], uint32_t(p0)};
+        _k[0] += 0x9E3779B9u;
+        _k[1] += 0xBB67AE85u;
+      }
+      return _c;
+    }
+
+  private:
+    std::array<uint32_t, 2> m_key; ///< Key (seed)
+    uint64_t m_stream;             ///< Upper half of the counter
+    uint64_t m_block{0};           ///< Next block, lower half of the counter
+    block_type m_out{};            ///< Buffered output block
+    size_t m_i{4};                 ///< Next word of m_out
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Engine for the i-th independent stream of a seed
+/// @tparam E Engine type
+/// @param _seed Seed shared by all streams
+/// @param _i Stream index, e.g., thread or task index
+/// @return Engine positioned at the start of stream @c _i
+///
+/// Xoshiro256++ streams are 2^192 apart (long_jump), Philox streams differ in
+/// the upper counter half. Other engines, e.g., the standard ones, fall back to
+/// seeding with @c _seed + @c _i, which for LCGs gives correlated streams.
+template<typename E>
+E
+stream(uint64_t _seed, size_t _i) {
+  if constexpr(std::is_same_v<E, xoshiro256pp>) {
+    xoshiro256pp e{_seed};
+    for(size_t i = 0; i < _i; ++i)
+      e.long_jump();
+    return e;
+  }
+  else if constexpr(std::is_same_v<E, philox4x32>)
+    return philox4x32{_seed, _i};
+  else
+    return E(typename E::result_type(_seed + _i));
+}
+
+}
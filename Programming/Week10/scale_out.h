@@ -0,0 +1,453 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Multi-process approximation of pi with a local coordinator (POSIX).
+///
+/// A coordinator hands out leases of consecutive blocks (see
+/// sequential::count_block) to worker processes over stream sockets. Workers
+/// are either forked children on a socketpair or separate processes reached
+/// through a Unix-domain socket, standing in for remote nodes. A worker streams
+/// back the count of every block as soon as it is done. If its connection
+/// breaks, or it completes no report until the deadline of its current lease,
+/// the blocks of its leases not yet reported go back into the pool of unleased
+/// work, and a forked worker that missed a deadline is killed. Each block is
+/// counted once no matter who ran it, so the result is identical to
+/// sequential::reproducible_pi.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "sequential_pi.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Multi-process scale-out
+////////////////////////////////////////////////////////////////////////////////
+namespace scale_out {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Lease of blocks [begin, end) of a run, coordinator to worker
+////////////////////////////////////////////////////////////////////////////////
+struct lease_msg {
+  uint64_t n;         ///< Samples of the whole run
+  uint64_t begin;     ///< First block
+  uint64_t end;       ///< One past the last block
+  uint64_t seed;      ///< Seed
+  uint64_t estimator; ///< Estimator, as its underlying value
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Count of one finished block, worker to coordinator
+////////////////////////////////////////////////////////////////////////////////
+struct report_msg {
+  uint64_t block;   ///< Block
+  uint64_t n_inner; ///< Inner samples of the block
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write a whole buffer, without SIGPIPE on a closed peer
+/// @return True on success
+inline bool
+send_all(int _fd, const void* _buf, size_t _n) {
+  const char* p = static_cast<const char*>(_buf);
+  while(_n > 0) {
+    ssize_t w = ::send(_fd, p, _n, MSG_NOSIGNAL);
+    if(w < 0 && errno == EINTR)
+      continue;
+    if(w <= 0)
+      return false;
+    p += w;
+    _n -= w;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read a whole buffer
+/// @return True on success, false on error or end of stream
+inline bool
+recv_all(int _fd, void* _buf, size_t _n) {
+  char* p = static_cast<char*>(_buf);
+  while(_n > 0) {
+    ssize_t r = ::recv(_fd, p, _n, 0);
+    if(r < 0 && errno == EINTR)
+      continue;
+    if(r <= 0)
+      return false;
+    p += r;
+    _n -= r;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Socket address of a Unix-domain socket path
+inline sockaddr_un
+address(const std::string& _path) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if(_path.size() >= sizeof(addr.sun_path))
+    throw std::invalid_argument("Socket path too long: " + _path);
+  std::strcpy(addr.sun_path, _path.c_str());
+  return addr;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Worker loop, count leased blocks until the coordinator hangs up
+/// @param _fd Connected socket
+inline void
+serve(int _fd) {
+  lease_msg l;
+  while(detail::recv_all(_fd, &l, sizeof(l)))
+    for(uint64_t b = l.begin; b < l.end; ++b) {
+      report_msg r{b, sequential::count_block(l.n, b, l.seed,
+                                              estimator(l.estimator))};
+      if(!detail::send_all(_fd, &r, sizeof(r)))
+        return;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Worker process reachable through a Unix-domain socket
+/// @param _path Socket path, replaced if it exists
+/// @param _sessions Number of coordinator connections to serve, one at a time
+inline void
+serve_unix(const std::string& _path, size_t _sessions = 1) {
+  sockaddr_un addr = detail::address(_path);
+  int lfd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if(lfd < 0)
+    throw std::runtime_error("socket: " + std::string(std::strerror(errno)));
+  ::unlink(_path.c_str());
+  if(::bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+     ::listen(lfd, 1) < 0) {
+    ::close(lfd);
+    throw std::runtime_error("bind/listen " + _path + ": " +
+                             std::strerror(errno));
+  }
+  for(size_t s = 0; s < _sessions; ++s) {
+    int fd = ::accept(lfd, nullptr, nullptr);
+    if(fd < 0)
+      break;
+    serve(fd);
+    ::close(fd);
+  }
+  ::close(lfd);
+  ::unlink(_path.c_str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Coordinator handing out leases of blocks to worker processes
+////////////////////////////////////////////////////////////////////////////////
+class coordinator {
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Counters of the last run
+    ////////////////////////////////////////////////////////////////////////////
+    struct run_stats {
+      size_t leases{0};      ///< Leases granted
+      size_t re_leased{0};   ///< Blocks leased again after a worker was lost
+      size_t lost{0};        ///< Workers lost
+      size_t expired{0};     ///< Workers lost to a missed lease deadline
+      size_t duplicates{0};  ///< Reports of blocks already counted
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors and special member functions
+    /// @{
+
+    /// @brief Construct without workers
+    /// @param _lease_blocks Blocks per lease
+    /// @param _lease_timeout Longest wait for the next report of a worker
+    ///                       holding leases
+    explicit coordinator(size_t _lease_blocks = 16,
+                         std::chrono::milliseconds _lease_timeout =
+                           std::chrono::seconds(10)) :
+      m_lease_blocks(std::max<size_t>(1, _lease_blocks)),
+      m_lease_timeout(std::max(_lease_timeout,
+                               std::chrono::milliseconds(1))) {}
+
+    /// @brief Destructor, hangs up on all workers and reaps forked ones
+    ~coordinator() {
+      for(worker& w : m_workers)
+        if(w.fd >= 0)
+          ::close(w.fd);
+      for(worker& w : m_workers)
+        if(w.pid > 0)
+          ::waitpid(w.pid, nullptr, 0);
+    }
+
+    /// @brief Copy constructor
+    coordinator(const coordinator&) = delete;
+    /// @brief Move constructor
+    coordinator(coordinator&&) = delete;
+    /// @brief Copy assignment
+    coordinator& operator=(const coordinator&) = delete;
+    /// @brief Move assignment
+    coordinator& operator=(coordinator&&) = delete;
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Fork worker processes connected by socketpairs
+    /// @param _n Number of workers
+    /// @param _body Worker loop run by the child on its socket, serve by
+    ///              default; the child exits when it returns
+    void spawn(size_t _n, const std::function<void(int)>& _body = serve) {
+      for(size_t i = 0; i < _n; ++i) {
+        int sv[2];
+        if(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+          throw std::runtime_error("socketpair: " +
+                                   std::string(std::strerror(errno)));
+        pid_t pid = ::fork();
+        if(pid < 0) {
+          ::close(sv[0]);
+          ::close(sv[1]);
+          throw std::runtime_error("fork: " +
+                                   std::string(std::strerror(errno)));
+        }
+        if(pid == 0) {
+          // Child: keep only its own end, so it sees the coordinator hang up
+          ::close(sv[0]);
+          for(worker& w : m_workers)
+            if(w.fd >= 0)
+              ::close(w.fd);
+          _body(sv[1]);
+          ::_exit(0);
+        }
+        ::close(sv[1]);
+        m_workers.push_back(worker{sv[0], pid, {}, {}, {}, 0});
+      }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Connect to a worker listening on a Unix-domain socket
+    /// @param _path Socket path, see serve_unix
+    void connect(const std::string& _path) {
+      sockaddr_un addr = detail::address(_path);
+      int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+      if(fd < 0 ||
+         ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::string err = std::strerror(errno);
+        if(fd >= 0)
+          ::close(fd);
+        throw std::runtime_error("connect " + _path + ": " + err);
+      }
+      m_workers.push_back(worker{fd, -1, {}, {}, {}, 0});
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Number of live workers
+    size_t size() const {
+      return std::count_if(m_workers.begin(), m_workers.end(),
+                           [](const worker& _w) { return _w.fd >= 0; });
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Counters of the last run
+    const run_stats& stats() const { return m_stats; }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Approximate pi on the workers
+    /// @param _n Number of samples
+    /// @param _seed Seed
+    /// @param _e Estimator
+    /// @return Approximation of pi, identical to sequential::reproducible_pi
+    ///
+    /// Every worker keeps up to two leases so it never waits for the next one.
+    /// A worker without a complete report for the lease timeout is dropped,
+    /// also if it stalls in the middle of one, so a hung worker delays the run
+    /// by at most that long. Throws std::runtime_error if all workers are lost
+    /// before the end.
+    double pi(size_t _n, uint64_t _seed = 0,
+              estimator _e = estimator::uniform) {
+      m_stats = run_stats{};
+      const size_t nb = sequential::num_blocks(_n);
+      std::vector<size_t> counts(nb);
+      std::vector<bool> done(nb, false);
+      size_t n_done = 0;
+      std::deque<range> unleased;
+      if(nb > 0)
+        unleased.push_back({0, nb});
+
+      auto grant = [&](worker& _w) {
+        while(_w.leases.size() < 2 && !unleased.empty()) {
+          range& r = unleased.front();
+          range l{r.begin, std::min(r.end, r.begin + m_lease_blocks)};
+          r.begin = l.end;
+          if(r.begin == r.end)
+            unleased.pop_front();
+          lease_msg m{_n, l.begin, l.end, _seed, uint64_t(_e)};
+          if(_w.leases.empty())
+            _w.deadline = clock::now() + m_lease_timeout;
+          _w.leases.push_back(l);
+          ++m_stats.leases;
+          if(!detail::send_all(_w.fd, &m, sizeof(m)))
+            return false;
+        }
+        return true;
+      };
+
+      auto lose = [&](worker& _w) {
+        for(range& l : _w.leases)
+          if(l.begin < l.end) {
+            m_stats.re_leased += l.end - l.begin;
+            unleased.push_back(l);
+          }
+        _w.leases.clear();
+        ::close(_w.fd);
+        _w.fd = -1;
+        ++m_stats.lost;
+      };
+
+      // A worker that missed its deadline may be hung rather than slow, kill a
+      // forked one so the destructor does not wait for it
+      auto expire = [&](worker& _w) {
+        if(_w.pid > 0)
+          ::kill(_w.pid, SIGKILL);
+        ++m_stats.expired;
+        lose(_w);
+      };
+
+      for(worker& w : m_workers)
+        if(w.fd >= 0 && !grant(w))
+          lose(w);
+
+      while(n_done < nb) {
+        std::vector<pollfd> pfds;
+        std::vector<worker*> ws;
+        for(worker& w : m_workers)
+          if(w.fd >= 0) {
+            pfds.push_back(pollfd{w.fd, POLLIN, 0});
+            ws.push_back(&w);
+          }
+        if(pfds.empty())
+          throw std::runtime_error("All scale-out workers lost");
+
+        // Wait until the earliest deadline of a worker holding leases
+        clock::time_point first = clock::now() + m_lease_timeout;
+        for(worker* w : ws)
+          if(!w->leases.empty())
+            first = std::min(first, w->deadline);
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(
+          first - clock::now());
+        if(::poll(pfds.data(), pfds.size(),
+                  int(std::max<int64_t>(0, wait.count()))) < 0) {
+          if(errno == EINTR)
+            continue;
+          throw std::runtime_error("poll: " +
+                                   std::string(std::strerror(errno)));
+        }
+
+        for(size_t i = 0; i < pfds.size(); ++i) {
+          worker& w = *ws[i];
+          if(pfds[i].revents == 0 || w.fd < 0)
+            continue;
+          // Take what arrived without blocking, a report may come in pieces.
+          // Waiting here for the rest would hold up the other workers, and a
+          // worker stalling mid-report misses its deadline like a silent one.
+          char* buf = reinterpret_cast<char*>(&w.report);
+          ssize_t got = ::recv(w.fd, buf + w.received,
+                               sizeof(w.report) - w.received, MSG_DONTWAIT);
+          if(got < 0 && (errno == EINTR || errno == EAGAIN ||
+                         errno == EWOULDBLOCK))
+            continue;
+          if(got > 0 && (w.received += got) < sizeof(w.report))
+            continue;
+          w.received = 0;
+          const report_msg& r = w.report;
+          if(got <= 0 || r.block >= nb)
+            lose(w);
+          else {
+            if(done[r.block])
+              ++m_stats.duplicates;
+            else {
+              done[r.block] = true;
+              counts[r.block] = r.n_inner;
+              ++n_done;
+            }
+            // Blocks of a lease are reported in order
+            if(!w.leases.empty() && w.leases.front().begin == r.block &&
+               ++w.leases.front().begin == w.leases.front().end)
+              w.leases.pop_front();
+            w.deadline = clock::now() + m_lease_timeout;
+          }
+          // Re-leased work goes to any live worker with room
+          for(worker& v : m_workers)
+            if(v.fd >= 0 && !grant(v))
+              lose(v);
+        }
+
+        const clock::time_point now = clock::now();
+        bool expired = false;
+        for(worker* w : ws)
+          if(w->fd >= 0 && !w->leases.empty() && w->deadline <= now) {
+            expire(*w);
+            expired = true;
+          }
+        if(expired)
+          for(worker& v : m_workers)
+            if(v.fd >= 0 && !grant(v))
+              lose(v);
+      }
+
+      size_t n_inner = 0;
+      for(size_t c : counts)
+        n_inner += c;
+      return 4.*n_inner/_n;
+    }
+
+  private:
+    using clock = std::chrono::steady_clock; ///< Clock of lease deadlines
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Range of blocks [begin, end)
+    ////////////////////////////////////////////////////////////////////////////
+    struct range {
+      size_t begin; ///< First block
+      size_t end;   ///< One past the last block
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Connection to one worker
+    ////////////////////////////////////////////////////////////////////////////
+    struct worker {
+      int fd;                     ///< Socket, -1 once lost
+      pid_t pid;                  ///< Forked child, -1 if connected
+      std::deque<range> leases;   ///< Outstanding leases, unreported blocks
+      clock::time_point deadline; ///< Deadline of the next report
+      report_msg report;          ///< Report being received
+      size_t received;            ///< Bytes of @c report received so far
+    };
+
+    size_t m_lease_blocks;                     ///< Blocks per lease
+    std::chrono::milliseconds m_lease_timeout; ///< Time for one report
+    std::vector<worker> m_workers;             ///< Workers, lost ones included
+    run_stats m_stats;                         ///< Counters of the last run
+};
+
+}
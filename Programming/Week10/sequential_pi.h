@@ -3,30 +3,148 @@
 /// @brief Sequential monte carlo approximation of pi.
 ////////////////////////////////////////////////////////////////////////////////
 
+#pragma once
+
+#include <algorithm>
 #include <random>
 
+#include "estimators.h"
+#include "rng.h"
+#include "simd_sampling.h"
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Collection of sequential algorithms
 ////////////////////////////////////////////////////////////////////////////////
 namespace sequential{
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Count samples in [-0.5, 0.5)^2 landing inside the circle
+/// @tparam Engine Random number engine
+/// @param _generator Engine
+/// @param _n Number of samples.
+/// @return Number of inner samples
+///
+/// Engines with a bulk fill (see rng.h) are drained through a small buffer,
+/// others go through std::uniform_real_distribution one value at a time.
+template<typename Engine>
+size_t
+count_inner(Engine& _generator, size_t _n) {
+  size_t n_inner = 0;
+  if constexpr(requires(double* _d) { _generator.fill(_d, _n, -0.5, 0.5); }) {
+    constexpr size_t B = 512;
+    double xy[2*B];
+    for(size_t i = 0; i < _n; i += B) {
+      size_t b = std::min(B, _n - i);
+      _generator.fill(xy, 2*b, -0.5, 0.5);
+      for(size_t j = 0; j < b; ++j)
+        n_inner += xy[2*j]*xy[2*j] + xy[2*j+1]*xy[2*j+1] < 0.25;
+    }
+  }
+  else {
+    std::uniform_real_distribution<double> distribution(-0.5,0.5);
+    for(size_t i = 0; i < _n; ++i) {
+      double x = distribution(_generator);
+      double y = distribution(_generator);
+      if(x*x + y*y < 0.25)
+        ++n_inner;
+    }
+  }
+  return n_inner;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Approximate pi with monte carlo
+/// @tparam Engine Random number engine for the scalar sampler
 /// @param _n Number of samples.
+/// @param _s Sampling kernel
 /// @return Approximation of pi
+template<typename Engine = std::default_random_engine>
 double
-pi(size_t _n) {
-  std::default_random_engine generator{0};
-  std::uniform_real_distribution<double> distribution(-0.5,0.5);
+pi(size_t _n, sampler _s = sampler::scalar) {
+  if(_s == sampler::simd)
+    return 4.f*simd::count_inner(_n, 0)/_n;
+  if(_s == sampler::integer)
+    return 4.f*simd::count_inner_int(_n, 0)/_n;
 
-  size_t n_inner = 0;
-  for(size_t i = 0; i < _n; ++i) {
-    double x = distribution(generator);
-    double y = distribution(generator);
-    if(x*x + y*y < 0.25)
-      ++n_inner;
+  Engine generator = rng::stream<Engine>(0, 0);
+  return 4.f*count_inner(generator, _n)/_n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Reproducible block decomposition
+///
+/// Sample i of a run belongs to logical block i/BLOCK_SIZE, and every block
+/// draws from its own Philox stream (or, for the estimators of estimators.h,
+/// from randoms addressed by i itself). The count of a block therefore depends
+/// only on the seed and the block index, never on who computes it, so summing
+/// block counts in any order or on any number of threads gives the same result.
+/// @{
+
+constexpr size_t BLOCK_SIZE = 1 << 16; ///< Samples per logical block
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Number of logical blocks, the last one may be partial
+/// @param _n Number of samples
+/// @return Number of blocks
+constexpr size_t
+num_blocks(size_t _n) {
+  return (_n + BLOCK_SIZE - 1)/BLOCK_SIZE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Count inner samples of one logical block
+/// @param _n Number of samples of the whole run
+/// @param _b Block index
+/// @param _seed Seed of the run
+/// @param _e Estimator
+/// @return Number of inner samples in block @c _b
+inline size_t
+count_block(size_t _n, size_t _b, uint64_t _seed,
+            estimator _e = estimator::uniform) {
+  size_t begin = _b*BLOCK_SIZE;
+  size_t end = std::min(_n, begin + BLOCK_SIZE);
+  switch(_e) {
+    case estimator::halton:
+      return estimators::count_halton(begin, end, _seed);
+    case estimator::sobol:
+      return estimators::count_sobol(begin, end, _seed);
+    case estimator::stratified:
+      return estimators::count_stratified(_n, begin, end, _seed);
+    case estimator::antithetic:
+      return estimators::count_antithetic(begin, end, _seed);
+    case estimator::uniform:
+      break;
   }
-  return 4.f*n_inner/_n;
+  rng::philox4x32 generator = rng::stream<rng::philox4x32>(_seed, _b);
+  return count_inner(generator, end - begin);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi with monte carlo over logical blocks
+/// @param _n Number of samples.
+/// @param _seed Seed
+/// @param _e Estimator
+/// @return Approximation of pi, bit-identical to parallel::reproducible_pi
+inline double
+reproducible_pi(size_t _n, uint64_t _seed = 0,
+                estimator _e = estimator::uniform) {
+  size_t n_inner = 0;
+  for(size_t b = 0; b < num_blocks(_n); ++b)
+    n_inner += count_block(_n, b, _seed, _e);
+  return 4.*n_inner/_n;
 }
 
-}
\ No newline at end of file
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Approximate pi with a chosen estimator
+/// @param _n Number of samples.
+/// @param _e Estimator
+/// @return Approximation of pi
+inline double
+pi(size_t _n, estimator _e) {
+  return reproducible_pi(_n, 0, _e);
+}
+
+/// @}
+////////////////////////////////////////////////////////////////////////////////
+
+}
@@ -0,0 +1,314 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Mergeable quantile (KLL) and cardinality (HyperLogLog) sketches.
+///
+/// Both sketches summarize a stream in memory that does not grow with its
+/// length, and two sketches of disjoint streams merge into the sketch of their
+/// concatenation, so workers fill their own sketch without synchronization and
+/// the results combine afterwards in any grouping.
+///
+/// The KLL sketch (Karnin, Lang, and Liberty) keeps a stack of compactors.
+/// Level h holds items of weight 2^h, and a full level is sorted and every
+/// other item, starting at a random offset, is promoted to the next level.
+/// Capacities shrink geometrically by 2/3 from the top level down, so about
+/// k/(1 - 2/3) + log2(n/k) items are kept, and quantiles are off by about
+/// 1.7/k in rank.
+///
+/// HyperLogLog (Flajolet et al.) hashes every item, uses the first p bits of
+/// the hash as a register index and keeps per register the largest position of
+/// the first one bit in the remaining bits. The harmonic mean of 2^register
+/// estimates the cardinality with a standard error of 1.04/sqrt(2^p), small
+/// cardinalities are counted from the empty registers instead (linear
+/// counting). Hashes are 64 bits, so there is no large range correction.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "parallel_reduce.h"
+#include "rng.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Mergeable streaming sketches
+////////////////////////////////////////////////////////////////////////////////
+namespace sketch {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief KLL quantile sketch
+/// @tparam T Item type, ordered by operator<
+////////////////////////////////////////////////////////////////////////////////
+template<typename T = double>
+class kll {
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors
+    /// @{
+
+    /// @brief Construct an empty sketch
+    /// @param _k Capacity of the top level, the accuracy parameter
+    /// @param _seed Seed of the compaction coin, give every worker its own
+    explicit kll(size_t _k = 200, uint64_t _seed = 0) :
+      m_k(_k), m_coin(_seed) {
+      if(m_k < 8)
+        throw std::invalid_argument("KLL sketch needs k >= 8.");
+      grow();
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    /// @brief Accuracy parameter
+    size_t k() const { return m_k; }
+
+    /// @brief Number of items added
+    size_t count() const { return m_n; }
+
+    /// @brief Number of items retained
+    size_t size() const { return m_size; }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Add an item
+    /// @param _x Item
+    void add(const T& _x) {
+      m_levels[0].push_back(_x);
+      ++m_n;
+      if(++m_size >= m_max_size)
+        compress();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Merge the sketch of another stream
+    /// @param _o Sketch with the same k
+    void merge(const kll& _o) {
+      if(_o.m_k != m_k)
+        throw std::invalid_argument("KLL sketches differ in k.");
+      while(m_levels.size() < _o.m_levels.size())
+        grow();
+      for(size_t h = 0; h < _o.m_levels.size(); ++h)
+        m_levels[h].insert(m_levels[h].end(), _o.m_levels[h].begin(),
+                           _o.m_levels[h].end());
+      m_n += _o.m_n;
+      m_size += _o.m_size;
+      while(m_size >= m_max_size)
+        compress();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Approximate quantile
+    /// @param _q Fraction in [0, 1]
+    /// @return Smallest retained item whose estimated rank reaches _q*count()
+    T quantile(double _q) const {
+      if(!(_q >= 0 && _q <= 1))
+        throw std::invalid_argument("Quantile fraction outside [0, 1].");
+      if(m_n == 0)
+        throw std::invalid_argument("Quantile of an empty sketch.");
+      auto ws = weighted();
+      const double target = _q*m_n;
+      uint64_t cum = 0;
+      for(const auto& [x, w] : ws)
+        if(double(cum += w) >= target)
+          return x;
+      return ws.back().first;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Approximate normalized rank
+    /// @param _x Item
+    /// @return Estimated fraction of items not greater than _x
+    double rank(const T& _x) const {
+      if(m_n == 0)
+        return 0.;
+      uint64_t r = 0;
+      for(size_t h = 0; h < m_levels.size(); ++h)
+        for(const T& y : m_levels[h])
+          if(!(_x < y))
+            r += uint64_t(1) << h;
+      return double(r)/m_n;
+    }
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Capacity of a level, smallest at the bottom
+    /// @param _h Level
+    size_t capacity(size_t _h) const {
+      const double depth = double(m_levels.size() - 1 - _h);
+      return std::max<size_t>(2, size_t(std::ceil(m_k*std::pow(C, depth))));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Add a level on top, which lowers the capacity of all others
+    void grow() {
+      m_levels.emplace_back();
+      m_max_size = 0;
+      for(size_t h = 0; h < m_levels.size(); ++h)
+        m_max_size += capacity(h);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Compact the lowest full level into the one above
+    void compress() {
+      for(size_t h = 0; h < m_levels.size(); ++h) {
+        if(m_levels[h].size() < capacity(h))
+          continue;
+        if(h + 1 == m_levels.size())
+          grow();
+
+        // Sort, hold back one item of an odd level, and promote every other
+        // item of the rest
+        std::vector<T>& l = m_levels[h];
+        std::sort(l.begin(), l.end());
+        const size_t even = l.size() & ~size_t(1);
+        const size_t offset = m_coin() >> 63;
+        std::vector<T>& up = m_levels[h + 1];
+        for(size_t i = offset; i < even; i += 2)
+          up.push_back(std::move(l[i]));
+        if(even < l.size())
+          l[0] = std::move(l.back());
+        l.resize(l.size() - even);
+        m_size -= even/2;
+        return;
+      }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Retained items with their weights, sorted by item
+    std::vector<std::pair<T, uint64_t>> weighted() const {
+      std::vector<std::pair<T, uint64_t>> ws;
+      ws.reserve(m_size);
+      for(size_t h = 0; h < m_levels.size(); ++h)
+        for(const T& x : m_levels[h])
+          ws.emplace_back(x, uint64_t(1) << h);
+      std::sort(ws.begin(), ws.end(), [](const auto& _a, const auto& _b) {
+        return _a.first < _b.first;
+      });
+      return ws;
+    }
+
+    static constexpr double C = 2./3.; ///< Capacity ratio of adjacent levels
+
+    size_t m_k;                          ///< Capacity of the top level
+    size_t m_n{0};                       ///< Items added
+    size_t m_size{0};                    ///< Items retained
+    size_t m_max_size{0};                ///< Sum of the level capacities
+    std::vector<std::vector<T>> m_levels; ///< Level h has weight 2^h
+    rng::xoshiro256pp m_coin;            ///< Compaction offsets
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief HyperLogLog cardinality sketch
+////////////////////////////////////////////////////////////////////////////////
+class hyperloglog {
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors
+    /// @{
+
+    /// @brief Construct an empty sketch
+    /// @param _p Index bits, 2^_p one-byte registers, in [4, 18]
+    explicit hyperloglog(unsigned _p = 14) : m_p(_p) {
+      if(m_p < 4 || m_p > 18)
+        throw std::invalid_argument("HyperLogLog needs 4 <= p <= 18.");
+      m_registers.assign(size_t(1) << m_p, 0);
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    /// @brief Index bits
+    unsigned p() const { return m_p; }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Add an item
+    /// @tparam U Item type with a std::hash specialization
+    /// @param _x Item
+    ///
+    /// std::hash of integers is often the identity, so it is mixed through
+    /// splitmix64 before use.
+    template<typename U>
+    void add(const U& _x) {
+      add_hash(rng::splitmix64{uint64_t(std::hash<U>{}(_x))}());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Add an item by its hash
+    /// @param _h Uniformly distributed 64-bit hash
+    void add_hash(uint64_t _h) {
+      const size_t i = _h >> (64 - m_p);
+      const uint64_t w = (_h << m_p) | (uint64_t(1) << (m_p - 1));
+      const uint8_t r = uint8_t(std::countl_zero(w) + 1);
+      m_registers[i] = std::max(m_registers[i], r);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Merge the sketch of another stream
+    /// @param _o Sketch with the same p
+    void merge(const hyperloglog& _o) {
+      if(_o.m_p != m_p)
+        throw std::invalid_argument("HyperLogLog sketches differ in p.");
+      for(size_t i = 0; i < m_registers.size(); ++i)
+        m_registers[i] = std::max(m_registers[i], _o.m_registers[i]);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Estimated number of distinct items
+    double estimate() const {
+      const double m = double(m_registers.size());
+      double sum = 0;
+      size_t zeros = 0;
+      for(uint8_t r : m_registers) {
+        sum += std::ldexp(1., -int(r));
+        zeros += r == 0;
+      }
+      const double alpha = m == 16 ? 0.673 : m == 32 ? 0.697 :
+                           m == 64 ? 0.709 : 0.7213/(1 + 1.079/m);
+      const double e = alpha*m*m/sum;
+      if(e <= 2.5*m && zeros > 0)
+        return m*std::log(m/zeros);
+      return e;
+    }
+
+  private:
+    unsigned m_p;                      ///< Index bits
+    std::vector<uint8_t> m_registers;  ///< Largest first-one position
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Fill sketches of a range in parallel and merge them
+/// @tparam It Random access iterator
+/// @tparam Make Sketch factory, called with the partition index
+/// @tparam Policy parallel::sequential_policy, async_policy, or pool_policy
+/// @param _first First element
+/// @param _last One past the last element
+/// @param _make Returns an empty sketch for a partition, e.g., a KLL sketch
+///              seeded with the index
+/// @param _p Policy, partitions as in parallel::parallel_reduce
+/// @return Merged sketch of all elements
+template<std::random_access_iterator It, typename Make, typename Policy>
+auto
+parallel_fill(It _first, It _last, Make _make, Policy _p) {
+  const size_t n = std::distance(_first, _last);
+  const size_t np = std::clamp<size_t>(n/parallel::detail::GRAIN, 1,
+                                       parallel::detail::max_threads(_p));
+  auto ss = parallel::detail::run(_p, np, [&](size_t _i) {
+    auto s = _make(_i);
+    for(It it = _first + n*_i/np, e = _first + n*(_i + 1)/np; it != e; ++it)
+      s.add(*it);
+    return s;
+  });
+
+  for(size_t i = 1; i < np; ++i)
+    ss[0].merge(ss[i]);
+  return std::move(ss[0]);
+}
+
+}
@@ -0,0 +1,366 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Out-of-core mean, variance, and extrema of binary files of doubles.
+///
+/// A file is cut into blocks of BLOCK_BYTES that workers claim from a shared
+/// counter. Every block is summarized on its own, in cache-sized chunks with
+/// two passes (sum, then squared deviations from the chunk mean), and the
+/// summaries are merged with the pairwise update of Chan et al., the merge
+/// form of Welford's algorithm. All moments are taken relative to the first
+/// value of the file, which keeps data with a large offset accurate. Block
+/// summaries are merged in block order, so the result does not depend on the
+/// number of threads.
+///
+/// Files are memory mapped. Each worker asks the kernel to read ahead the block
+/// it will probably claim next (MADV_WILLNEED) and drops the mapping of blocks
+/// it is done with (MADV_DONTNEED), so the resident set stays small for files
+/// larger than memory. Files that cannot be mapped, e.g. on file systems
+/// without mmap support, are read with pread into per-worker page-aligned
+/// buffers instead.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief How files are read
+////////////////////////////////////////////////////////////////////////////////
+enum class file_access {
+  mmap, ///< Memory map, pread if the file cannot be mapped
+  pread ///< pread into page-aligned buffers
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Streaming statistics
+////////////////////////////////////////////////////////////////////////////////
+namespace streaming {
+
+constexpr size_t BLOCK_BYTES = size_t(8) << 20; ///< Bytes per block
+constexpr size_t CHUNK = 2048;                  ///< Values per two-pass chunk
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Count, mean, variance, and extrema of a sequence
+////////////////////////////////////////////////////////////////////////////////
+struct summary {
+  size_t n{0};     ///< Number of values
+  double mean{0};  ///< Mean
+  double m2{0};    ///< Sum of squared deviations from the mean
+  double min{std::numeric_limits<double>::infinity()};  ///< Minimum
+  double max{-std::numeric_limits<double>::infinity()}; ///< Maximum
+
+  /// @brief Sample variance, 0 for fewer than two values
+  double variance() const { return n > 1 ? m2/(n - 1) : 0.; }
+
+  /// @brief Sample standard deviation
+  double stddev() const { return std::sqrt(variance()); }
+
+  /// @brief Add one value (Welford)
+  void add(double _x) {
+    ++n;
+    double d = _x - mean;
+    mean += d/n;
+    m2 += d*(_x - mean);
+    min = std::min(min, _x);
+    max = std::max(max, _x);
+  }
+
+  /// @brief Merge the summary of another sequence (Chan et al.)
+  void merge(const summary& _o) {
+    if(_o.n == 0)
+      return;
+    size_t t = n + _o.n;
+    double d = _o.mean - mean;
+    mean += d*_o.n/t;
+    m2 += _o.m2 + d*d*(double(n)*_o.n/t);
+    n = t;
+    min = std::min(min, _o.min);
+    max = std::max(max, _o.max);
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Summarize values in memory relative to a shift
+/// @param _x Values
+/// @param _n Number of values
+/// @param _shift Subtracted from every value before the moments
+/// @return Summary of _x - _shift, but with min and max of _x
+///
+/// With a shift near the data the means stay small, so their rounding errors
+/// do not pile up in m2 over many merges (Welford and Chan lose about the
+/// square of the relative precision of the mean).
+inline summary
+summarize(const double* _x, size_t _n, double _shift) {
+  summary s;
+  for(size_t i = 0; i < _n; i += CHUNK) {
+    const size_t k = std::min(CHUNK, _n - i);
+    const double* x = _x + i;
+
+    summary c;
+    double sum = 0;
+    for(size_t j = 0; j < k; ++j) {
+      sum += x[j] - _shift;
+      c.min = x[j] < c.min ? x[j] : c.min;
+      c.max = x[j] > c.max ? x[j] : c.max;
+    }
+    c.n = k;
+    c.mean = sum/k;
+    for(size_t j = 0; j < k; ++j) {
+      double d = x[j] - _shift - c.mean;
+      c.m2 += d*d;
+    }
+    s.merge(c);
+  }
+  return s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Error with the message of errno
+/// @param _what Failed operation
+inline std::runtime_error
+error(const std::string& _what) {
+  return std::runtime_error(_what + ": " + std::strerror(errno));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read-only file descriptor, closed on destruction
+////////////////////////////////////////////////////////////////////////////////
+class file {
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors and special member functions
+    /// @{
+
+    /// @brief Open a file, throws std::runtime_error on failure
+    /// @param _path File
+    explicit file(const std::string& _path) :
+      m_fd(::open(_path.c_str(), O_RDONLY | O_CLOEXEC)) {
+      if(m_fd < 0)
+        throw error("open " + _path);
+      struct stat st;
+      if(::fstat(m_fd, &st) != 0) {
+        ::close(m_fd);
+        throw error("fstat " + _path);
+      }
+      m_size = size_t(st.st_size);
+    }
+
+    file(const file&) = delete;
+    file& operator=(const file&) = delete;
+
+    ~file() { ::close(m_fd); }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    /// @brief Descriptor
+    int fd() const { return m_fd; }
+
+    /// @brief Size in bytes
+    size_t size() const { return m_size; }
+
+  private:
+    int m_fd;      ///< Descriptor
+    size_t m_size; ///< Size in bytes
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read-only memory mapping of a whole file, unmapped on destruction
+////////////////////////////////////////////////////////////////////////////////
+class mapping {
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors and special member functions
+    /// @{
+
+    /// @brief Map a file, check valid() for success
+    /// @param _f File, must outlive the mapping
+    explicit mapping(const file& _f) : m_size(_f.size()) {
+      if(m_size == 0)
+        return;
+      void* p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, _f.fd(), 0);
+      if(p != MAP_FAILED) {
+        m_data = static_cast<const char*>(p);
+        ::madvise(p, m_size, MADV_SEQUENTIAL);
+      }
+    }
+
+    mapping(const mapping&) = delete;
+    mapping& operator=(const mapping&) = delete;
+
+    ~mapping() {
+      if(m_data)
+        ::munmap(const_cast<char*>(m_data), m_size);
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    /// @brief Whether the file is mapped
+    bool valid() const { return m_data != nullptr; }
+
+    /// @brief Mapped bytes
+    const char* data() const { return m_data; }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Advise the kernel about a block, clipped to the file
+    /// @param _b Block index
+    /// @param _advice MADV_WILLNEED, MADV_DONTNEED, ...
+    void advise(size_t _b, int _advice) const {
+      size_t begin = _b*BLOCK_BYTES;
+      if(m_data && begin < m_size)
+        ::madvise(const_cast<char*>(m_data) + begin,
+                  std::min(BLOCK_BYTES, m_size - begin), _advice);
+    }
+
+  private:
+    const char* m_data{nullptr}; ///< Mapped bytes, page aligned
+    size_t m_size;               ///< Bytes
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read a range of a file completely
+/// @param _fd Descriptor
+/// @param _buf Destination
+/// @param _len Bytes
+/// @param _offset Offset in the file
+inline void
+pread_all(int _fd, char* _buf, size_t _len, size_t _offset) {
+  while(_len > 0) {
+    ssize_t r = ::pread(_fd, _buf, _len, off_t(_offset));
+    if(r < 0 && errno == EINTR)
+      continue;
+    if(r <= 0)
+      throw r < 0 ? error("pread") : std::runtime_error("pread: short file");
+    _buf += r;
+    _offset += size_t(r);
+    _len -= size_t(r);
+  }
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Summarize values in memory
+/// @param _x Values
+/// @param _n Number of values
+/// @return Summary of the values
+inline summary
+summarize(const double* _x, size_t _n) {
+  const double shift = _n ? _x[0] : 0.;
+  summary s = detail::summarize(_x, _n, shift);
+  s.mean += shift;
+  return s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Summarize a binary file of native-endian doubles
+/// @param _path File
+/// @param _nt Number of worker threads
+/// @param _a How the file is read
+/// @return Summary of all values, independent of @c _nt and @c _a
+///
+/// Throws std::runtime_error if the file cannot be read, and
+/// std::invalid_argument if its size is not a multiple of sizeof(double).
+inline summary
+file_stats(const std::string& _path,
+           size_t _nt = std::max(1u, std::thread::hardware_concurrency()),
+           file_access _a = file_access::mmap) {
+  static_assert(BLOCK_BYTES%sizeof(double) == 0);
+
+  detail::file f(_path);
+  if(f.size()%sizeof(double) != 0)
+    throw std::invalid_argument(_path + " is not a file of doubles.");
+
+  const size_t nb = (f.size() + BLOCK_BYTES - 1)/BLOCK_BYTES;
+  _nt = std::max<size_t>(1, std::min(_nt, nb));
+  std::vector<summary> parts(nb);
+  std::atomic<size_t> next{0};
+  auto len = [&f](size_t _b) {
+    return std::min(BLOCK_BYTES, f.size() - _b*BLOCK_BYTES);
+  };
+
+  std::unique_ptr<detail::mapping> m;
+  if(_a == file_access::mmap) {
+    m = std::make_unique<detail::mapping>(f);
+    if(!m->valid())
+      m.reset();
+  }
+
+  // Every block is shifted by the first value, see detail::summarize
+  double shift = 0;
+  if(f.size() > 0)
+    detail::pread_all(f.fd(), reinterpret_cast<char*>(&shift), sizeof(shift),
+                      0);
+
+  auto worker = [&]() {
+    if(m) {
+      for(size_t b = next++; b < nb; b = next++) {
+        m->advise(b + _nt, MADV_WILLNEED);
+        parts[b] = detail::summarize(
+          reinterpret_cast<const double*>(m->data() + b*BLOCK_BYTES),
+          len(b)/sizeof(double), shift);
+        m->advise(b, MADV_DONTNEED);
+      }
+      return;
+    }
+
+    std::unique_ptr<double, void(*)(void*)> buf(
+      static_cast<double*>(std::aligned_alloc(4096, BLOCK_BYTES)), std::free);
+    if(!buf)
+      throw std::bad_alloc();
+    for(size_t b = next++; b < nb; b = next++) {
+      if(b + _nt < nb)
+        ::posix_fadvise(f.fd(), off_t((b + _nt)*BLOCK_BYTES),
+                        off_t(len(b + _nt)), POSIX_FADV_WILLNEED);
+      detail::pread_all(f.fd(), reinterpret_cast<char*>(buf.get()), len(b),
+                        b*BLOCK_BYTES);
+      parts[b] = detail::summarize(buf.get(), len(b)/sizeof(double), shift);
+    }
+  };
+
+  if(!m)
+    ::posix_fadvise(f.fd(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  // The calling thread is one of the workers
+  {
+    std::vector<std::future<void>> fts;
+    fts.reserve(_nt - 1);
+    for(size_t i = 1; i < _nt; ++i)
+      fts.emplace_back(std::async(std::launch::async, worker));
+    worker();
+    for(auto& ft : fts)
+      ft.get();
+  }
+
+  summary s;
+  for(const summary& p : parts)
+    s.merge(p);
+  s.mean += shift;
+  return s;
+}
+
+}
@@ -0,0 +1,482 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Dataflow task graph with continuations on a thread pool.
+///
+/// A task is submitted to the pool only once all of its inputs are ready:
+/// then() chains a task after one input and when_all() after several, and the
+/// task finishing last hands its dependents to the pool. No worker ever waits
+/// for another task, so graphs of any depth run on a pool of any size, which a
+/// pool task calling future::get on a sibling does not. Only task::get, meant
+/// for the thread that built the graph, blocks.
+///
+/// Exceptions of a task are stored and passed on to its dependents, which are
+/// then not run, and rethrown by get.
+///
+/// With tracing on, the graph records the start and finish of every task and
+/// its inputs. analyze() derives total work, span (the longest chain of
+/// dependent task durations), and the critical path from it, and write_trace()
+/// writes the Chrome trace event format (chrome://tracing, Perfetto).
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "benchmark.h"
+#include "thread_pool.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Dataflow execution
+////////////////////////////////////////////////////////////////////////////////
+namespace dataflow {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Recorded execution of one task
+////////////////////////////////////////////////////////////////////////////////
+struct trace_event {
+  std::string name;          ///< Task name
+  std::vector<size_t> deps;  ///< Ids of the inputs
+  double start{0};           ///< Seconds since the graph was created
+  double finish{0};          ///< Seconds since the graph was created
+  size_t thread{0};          ///< Index of the thread in order of appearance
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Work, span, and critical path of a traced graph
+////////////////////////////////////////////////////////////////////////////////
+struct profile {
+  double work{0};                   ///< Sum of all task durations
+  double span{0};                   ///< Duration of the critical path
+  std::vector<size_t> critical_path; ///< Task ids, first to last
+
+  /// @brief Average parallelism, the speedup bound on unlimited threads
+  double parallelism() const { return span > 0 ? work/span : 0.; }
+};
+
+class graph;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Implementation details
+////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+/// @brief Stored value of a task result, void as std::monostate
+template<typename T>
+using value_t = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Completion state shared by a task, its handles, and dependents
+////////////////////////////////////////////////////////////////////////////////
+struct node {
+  size_t id{0};                                ///< Id in the graph
+  std::mutex mutex;                            ///< Guards everything below
+  std::condition_variable cv;                  ///< Signals completion
+  bool done{false};                            ///< Finished or failed
+  std::exception_ptr error;                    ///< Exception of the task
+  std::vector<std::function<void()>> next;     ///< Continuations
+
+  ////////////////////////////////////////////////////////////////////////////
+  /// @brief Run a function once the node is done, right away if it is
+  /// @param _f Continuation, called on the completing thread
+  void on_done(std::function<void()> _f) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if(!done) {
+        next.push_back(std::move(_f));
+        return;
+      }
+    }
+    _f();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  /// @brief Mark done, wake waiters, and run the continuations
+  void complete() {
+    std::vector<std::function<void()>> fs;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      done = true;
+      fs.swap(next);
+    }
+    cv.notify_all();
+    for(auto& f : fs)
+      f();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  /// @brief Wait for completion
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return done; });
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Node holding a result
+/// @tparam T Result type
+////////////////////////////////////////////////////////////////////////////////
+template<typename T>
+struct state : node {
+  std::optional<value_t<T>> value; ///< Result, set before done
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Call a continuation with an input value, or without for void
+template<typename F, typename T>
+auto
+call(F& _f, const T& _x) {
+  if constexpr(std::is_same_v<T, std::monostate> && std::is_invocable_v<F&>)
+    return _f();
+  else
+    return _f(_x);
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Handle to the future result of a task in a graph
+/// @tparam T Result type, may be void
+////////////////////////////////////////////////////////////////////////////////
+template<typename T>
+class task {
+  public:
+    using value_type = T; ///< Result type
+
+    /// @brief Id of the task in its graph, the index of its trace event
+    size_t id() const { return m_state->id; }
+
+    /// @brief Whether the task finished or failed
+    bool ready() const {
+      std::lock_guard<std::mutex> lock(m_state->mutex);
+      return m_state->done;
+    }
+
+    /// @brief Wait for the task, blocks the calling thread
+    void wait() const { m_state->wait(); }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Wait for the result, rethrowing the exception of the task or of
+    ///        an input
+    /// @return Copy of the result
+    T get() const {
+      m_state->wait();
+      if(m_state->error)
+        std::rethrow_exception(m_state->error);
+      if constexpr(!std::is_void_v<T>)
+        return *m_state->value;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Chain a task on the result
+    /// @tparam F Callable, F(const T&), or F() for void T
+    /// @param _name Name in the trace
+    /// @param _f Callable, run on the pool once this task finished
+    /// @return Task of the result of @c _f
+    template<typename F>
+    auto then(std::string _name, F _f) const;
+
+  private:
+    friend class graph;
+
+    /// @brief Construct from state
+    task(graph* _g, std::shared_ptr<detail::state<T>> _s) :
+      m_graph(_g), m_state(std::move(_s)) {}
+
+    graph* m_graph;                            ///< Owning graph
+    std::shared_ptr<detail::state<T>> m_state; ///< Shared state
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Builder and owner of tasks running on a thread pool
+////////////////////////////////////////////////////////////////////////////////
+class graph {
+  public:
+    using clock = std::chrono::steady_clock; ///< Trace clock
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors and special member functions
+    /// @{
+
+    /// @brief Construct an empty graph
+    /// @param _pool Pool running the tasks
+    /// @param _trace Whether to record task start and finish
+    explicit graph(thread_pool& _pool, bool _trace = true) :
+      m_pool(_pool), m_trace(_trace), m_t0(clock::now()) {}
+
+    graph(const graph&) = delete;
+    graph& operator=(const graph&) = delete;
+
+    /// @brief Destructor, waits for all tasks
+    ~graph() { wait(); }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Start a task without inputs
+    /// @tparam F Callable, F()
+    /// @param _name Name in the trace
+    /// @param _f Callable
+    /// @return Task of the result of @c _f
+    template<typename F>
+    auto spawn(std::string _name, F _f) {
+      using R = std::invoke_result_t<F&>;
+      return make<R>(std::move(_name), {}, [_f = std::move(_f)]() mutable {
+        return _f();
+      });
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Task completing once all inputs did
+    /// @tparam T Result types of the inputs
+    /// @param _name Name in the trace
+    /// @param _ts Input tasks
+    /// @return Task of the tuple of the input results, void as monostate
+    template<typename... T>
+    auto when_all(std::string _name, const task<T>&... _ts) {
+      using R = std::tuple<detail::value_t<T>...>;
+      return make<R>(std::move(_name), {_ts.m_state...},
+                     [... ss = _ts.m_state]() { return R(*ss->value...); });
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Task completing once all inputs did
+    /// @tparam T Result type of the inputs
+    /// @param _name Name in the trace
+    /// @param _ts Input tasks
+    /// @return Task of the vector of the input results in input order
+    template<typename T>
+    auto when_all(std::string _name, const std::vector<task<T>>& _ts) {
+      using R = std::vector<detail::value_t<T>>;
+      std::vector<std::shared_ptr<detail::node>> deps;
+      std::vector<std::shared_ptr<detail::state<T>>> ss;
+      for(const task<T>& t : _ts) {
+        deps.push_back(t.m_state);
+        ss.push_back(t.m_state);
+      }
+      return make<R>(std::move(_name), std::move(deps),
+                     [ss = std::move(ss)]() {
+        R r;
+        r.reserve(ss.size());
+        for(const auto& s : ss)
+          r.push_back(*s->value);
+        return r;
+      });
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Wait until every task created so far finished, blocks the
+    ///        calling thread
+    void wait() {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this]() { return m_running == 0; });
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Recorded events indexed by task id, complete after wait()
+    std::vector<trace_event> trace() const {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_events;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Work, span, and critical path of the recorded events
+    ///
+    /// Inputs have smaller ids than their dependents, so one pass in id order
+    /// finds the longest chain. Times waiting in the pool queue are not part
+    /// of the span.
+    profile analyze() const {
+      std::vector<trace_event> es = trace();
+      profile p;
+      std::vector<double> end(es.size());
+      std::vector<size_t> prev(es.size(), SIZE_MAX);
+      size_t last = SIZE_MAX;
+      for(size_t i = 0; i < es.size(); ++i) {
+        double d = es[i].finish - es[i].start;
+        p.work += d;
+        end[i] = d;
+        for(size_t j : es[i].deps)
+          if(end[j] + d > end[i]) {
+            end[i] = end[j] + d;
+            prev[i] = j;
+          }
+        if(last == SIZE_MAX || end[i] > end[last])
+          last = i;
+      }
+      if(last == SIZE_MAX)
+        return p;
+      p.span = end[last];
+      for(size_t i = last; i != SIZE_MAX; i = prev[i])
+        p.critical_path.insert(p.critical_path.begin(), i);
+      return p;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Write the recorded events in the Chrome trace event format
+    /// @param _os Output
+    void write_trace(std::ostream& _os) const {
+      // Format locally, leaving the flags and precision of _os alone
+      std::vector<trace_event> es = trace();
+      std::ostringstream oss;
+      oss << "[\n" << std::fixed << std::setprecision(3);
+      for(size_t i = 0; i < es.size(); ++i)
+        oss << "  {\"name\": " << bench::detail::quoted(es[i].name, '\\')
+            << ", \"ph\": \"X\", \"pid\": 0, \"tid\": " << es[i].thread
+            << ", \"ts\": " << es[i].start*1e6
+            << ", \"dur\": " << (es[i].finish - es[i].start)*1e6
+            << ", \"args\": {\"id\": " << i << "}}"
+            << (i + 1 < es.size() ? ",\n" : "\n");
+      oss << "]\n";
+      _os << oss.str();
+    }
+
+  private:
+    template<typename T>
+    friend class task;
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Create a task that runs once all inputs are done
+    /// @tparam R Result type
+    /// @param _name Name in the trace
+    /// @param _deps Inputs
+    /// @param _body Computes the result from the inputs
+    /// @return Task handle
+    ///
+    /// If an input failed, the task fails with its exception without running
+    /// the body.
+    template<typename R, typename B>
+    task<R> make(std::string _name,
+                 std::vector<std::shared_ptr<detail::node>> _deps, B _body) {
+      auto s = std::make_shared<detail::state<R>>();
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        s->id = m_events.size();
+        trace_event e;
+        e.name = std::move(_name);
+        for(const auto& d : _deps)
+          e.deps.push_back(d->id);
+        m_events.push_back(std::move(e));
+        ++m_running;
+      }
+
+      auto run = [this, s, deps = _deps, body = std::move(_body)]() mutable {
+        for(const auto& d : deps)
+          if(d->error && !s->error)
+            s->error = d->error;
+        deps.clear();
+
+        const double t0 = now();
+        if(!s->error) {
+          try {
+            if constexpr(std::is_void_v<R>) {
+              body();
+              s->value.emplace();
+            }
+            else
+              s->value.emplace(body());
+          }
+          catch(...) {
+            s->error = std::current_exception();
+          }
+        }
+        record(s->id, t0, now());
+        s->complete();
+        finished();
+      };
+
+      if(_deps.empty()) {
+        submit(std::move(run));
+        return task<R>(this, std::move(s));
+      }
+
+      // The last input to finish submits the task
+      auto pending = std::make_shared<std::atomic<size_t>>(_deps.size());
+      auto shared_run = std::make_shared<decltype(run)>(std::move(run));
+      for(const auto& d : _deps)
+        d->on_done([this, pending, shared_run]() {
+          if(--*pending == 0)
+            submit([shared_run]() { (*shared_run)(); });
+        });
+      return task<R>(this, std::move(s));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Run a function on the pool, dropping the future
+    template<typename F>
+    void submit(F&& _f) {
+      m_pool.submit(std::forward<F>(_f));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Seconds since the graph was created
+    double now() const {
+      return std::chrono::duration<double>(clock::now() - m_t0).count();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Record start and finish of a task
+    void record(size_t _id, double _start, double _finish) {
+      if(!m_trace)
+        return;
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_events[_id].start = _start;
+      m_events[_id].finish = _finish;
+      m_events[_id].thread = m_threads.try_emplace(std::this_thread::get_id(),
+                                                   m_threads.size())
+                             .first->second;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Count a task as finished
+    ///
+    /// Notifies under the lock, as the graph may be destroyed as soon as
+    /// wait() can see the count drop to zero.
+    void finished() {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(--m_running == 0)
+        m_cv.notify_all();
+    }
+
+    thread_pool& m_pool;                           ///< Pool running tasks
+    bool m_trace;                                  ///< Record start/finish
+    clock::time_point m_t0;                        ///< Creation time
+    mutable std::mutex m_mutex;                    ///< Guards everything below
+    std::condition_variable m_cv;                  ///< Signals no running task
+    size_t m_running{0};                           ///< Unfinished tasks
+    std::vector<trace_event> m_events;             ///< Event per task id
+    std::map<std::thread::id, size_t> m_threads;   ///< Thread indices
+};
+
+template<typename T>
+template<typename F>
+auto
+task<T>::then(std::string _name, F _f) const {
+  using V = detail::value_t<T>;
+  using R = decltype(detail::call(_f, std::declval<const V&>()));
+  return m_graph->template make<R>(
+    std::move(_name), {m_state},
+    [s = m_state, _f = std::move(_f)]() mutable -> R {
+      return detail::call(_f, *s->value);
+    });
+}
+
+}
@@ -0,0 +1,40 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Pass/fail reporting shared by the test drivers.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Checks of one test driver, reported as they run
+////////////////////////////////////////////////////////////////////////////////
+class checks {
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Report a check
+    /// @param _name Check
+    /// @param _ok Passed
+    /// @return @c _ok
+    bool operator()(const std::string& _name, bool _ok) {
+      std::cout << std::setw(48) << std::left << _name << std::right
+                << (_ok ? "ok" : "FAILED") << std::endl;
+      m_failed += !_ok;
+      return _ok;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Number of failed checks
+    size_t failed() const { return m_failed; }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Exit status of the driver, failure if any check failed
+    int status() const { return m_failed ? EXIT_FAILURE : EXIT_SUCCESS; }
+
+  private:
+    size_t m_failed{0}; ///< Failed checks so far
+};
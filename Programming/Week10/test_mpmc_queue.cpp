@@ -0,0 +1,278 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Testing/timing of the bounded MPMC queue.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "benchmark.h"
+#include "mpmc_queue.h"
+#include "test_check.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+constexpr size_t MAX_N_THREADS = 64; ///< Max threads per side in experiment
+constexpr size_t N = 1 << 20;        ///< Items per timed run
+constexpr size_t CAPACITY = 1024;    ///< Capacity of the timed queues
+constexpr size_t BATCH = 64;         ///< Items per bulk dequeue
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Bounded queue behind a mutex and two condition variables, the
+///        baseline of the timings
+////////////////////////////////////////////////////////////////////////////////
+template<typename T>
+class locked_queue {
+  public:
+    /// @brief Construct an empty queue
+    /// @param _capacity Capacity
+    explicit locked_queue(size_t _capacity) : m_ring(_capacity) {}
+
+    /// @brief Queue an item, waiting for room
+    /// @param _x Item
+    void push(T _x) {
+      unique_lock<mutex> lock(m_mutex);
+      m_not_full.wait(lock, [this]() { return m_size < m_ring.size(); });
+      m_ring[(m_head + m_size++)%m_ring.size()] = std::move(_x);
+      lock.unlock();
+      m_not_empty.notify_one();
+    }
+
+    /// @brief Dequeue an item, waiting for one
+    T pop() {
+      unique_lock<mutex> lock(m_mutex);
+      m_not_empty.wait(lock, [this]() { return m_size > 0; });
+      T x = std::move(m_ring[m_head]);
+      m_head = (m_head + 1)%m_ring.size();
+      --m_size;
+      lock.unlock();
+      m_not_full.notify_one();
+      return x;
+    }
+
+  private:
+    mutex m_mutex;                ///< Guards everything below
+    condition_variable m_not_full;  ///< Signaled after a pop
+    condition_variable m_not_empty; ///< Signaled after a push
+    vector<T> m_ring;             ///< Items
+    size_t m_head{0};             ///< Oldest item
+    size_t m_size{0};             ///< Number of items
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Item counting its live instances
+////////////////////////////////////////////////////////////////////////////////
+struct counted {
+  static inline atomic<int> live{0}; ///< Instances alive
+  int v{0};                          ///< Value
+
+  counted() { ++live; }
+  explicit counted(int _v) : v{_v} { ++live; }
+  counted(counted&& _o) noexcept : v{_o.v} { ++live; }
+  counted& operator=(counted&& _o) noexcept { v = _o.v; return *this; }
+  ~counted() { --live; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Stream N items from producers to consumers
+/// @tparam Q Queue type with push and pop
+/// @param _q Queue
+/// @param _np Producers
+/// @param _nc Consumers, N must be divisible by @c _nc
+/// @return Sum of the items received
+template<typename Q>
+uint64_t
+stream(Q& _q, size_t _np, size_t _nc) {
+  atomic<uint64_t> sum{0};
+  vector<thread> ts;
+  for(size_t p = 0; p < _np; ++p)
+    ts.emplace_back([&_q, p, _np]() {
+      for(size_t i = N*p/_np; i < N*(p + 1)/_np; ++i)
+        _q.push(uint64_t(i));
+    });
+  for(size_t c = 0; c < _nc; ++c)
+    ts.emplace_back([&_q, &sum, _nc]() {
+      uint64_t s = 0;
+      for(size_t i = 0; i < N/_nc; ++i)
+        s += _q.pop();
+      sum += s;
+    });
+  for(thread& t : ts)
+    t.join();
+  return sum;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Stream N items with bulk dequeues
+/// @param _q Queue
+/// @param _np Producers
+/// @param _nc Consumers
+/// @return Sum of the items received
+uint64_t
+stream_bulk(mpmc_queue<uint64_t>& _q, size_t _np, size_t _nc) {
+  atomic<uint64_t> sum{0};
+  atomic<size_t> received{0};
+  vector<thread> ts;
+  for(size_t p = 0; p < _np; ++p)
+    ts.emplace_back([&_q, p, _np]() {
+      for(size_t i = N*p/_np; i < N*(p + 1)/_np; ++i)
+        _q.push(uint64_t(i));
+    });
+  for(size_t c = 0; c < _nc; ++c)
+    ts.emplace_back([&_q, &sum, &received]() {
+      uint64_t batch[BATCH];
+      uint64_t s = 0;
+      while(received.load(memory_order_relaxed) < N) {
+        size_t k = _q.try_pop_bulk(batch, BATCH);
+        if(k == 0) {
+          this_thread::yield();
+          continue;
+        }
+        for(size_t i = 0; i < k; ++i)
+          s += batch[i];
+        received += k;
+      }
+      sum += s;
+    });
+  for(thread& t : ts)
+    t.join();
+  return sum;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Main driver
+/// @return Success/Failure
+int
+main() {
+  checks check;
+
+  // Single thread semantics
+  {
+    mpmc_queue<int> q(5);
+    check("capacity rounded to a power of two", q.capacity() == 8);
+    bool fifo = true;
+    for(int i = 0; i < 8; ++i)
+      fifo &= q.try_push(i);
+    fifo &= !q.try_push(8) && q.size() == 8;
+    int x;
+    for(int i = 0; i < 3; ++i)
+      fifo &= q.try_pop(x) && x == i;
+    vector<int> b;
+    fifo &= q.try_pop_bulk(back_inserter(b), 4) == 4 &&
+            b == vector<int>{3, 4, 5, 6};
+    q.push(9);
+    fifo &= q.pop() == 7 && q.pop() == 9 && !q.try_pop(x) && q.size() == 0;
+    check("FIFO, full, and empty", fifo);
+
+    bool thrown = false;
+    try {
+      mpmc_queue<int> z(0);
+    }
+    catch(const invalid_argument&) {
+      thrown = true;
+    }
+    check("zero capacity throws", thrown);
+
+    {
+      mpmc_queue<counted> c(16);
+      for(int i = 0; i < 10; ++i)
+        c.emplace(i);
+      counted y;
+      c.try_pop(y);
+    }
+    check("queued items destroyed", counted::live == 0);
+  }
+
+  // Every item arrives exactly once, and in order per producer, with all
+  // kinds of dequeues mixed on a small queue
+  {
+    const size_t np = 4, nc = 4, m = 200'000;
+    mpmc_queue<uint64_t> q(64);
+    vector<vector<uint64_t>> got(nc);
+    atomic<size_t> received{0};
+    vector<thread> ts;
+    for(size_t p = 0; p < np; ++p)
+      ts.emplace_back([&q, p]() {
+        for(size_t i = 0; i < m; ++i) {
+          uint64_t x = p << 32 | i;
+          if(i%2 == 0)
+            q.push(x);
+          else
+            while(!q.try_push(x))
+              this_thread::yield();
+        }
+      });
+    for(size_t c = 0; c < nc; ++c)
+      ts.emplace_back([&, c]() {
+        uint64_t batch[16];
+        while(received.load() < np*m) {
+          uint64_t x;
+          size_t k = 0;
+          if(c%2 == 0 && q.try_pop(x)) {
+            got[c].push_back(x);
+            k = 1;
+          }
+          else if(c%2 == 1 && (k = q.try_pop_bulk(batch, 16)))
+            got[c].insert(got[c].end(), batch, batch + k);
+          if(k)
+            received += k;
+          else
+            this_thread::yield();
+        }
+      });
+    for(thread& t : ts)
+      t.join();
+
+    bool ordered = true;
+    vector<size_t> seen(np*m, 0);
+    for(const auto& g : got) {
+      vector<int64_t> last(np, -1);
+      for(uint64_t x : g) {
+        size_t p = x >> 32, i = x & 0xFFFFFFFF;
+        ++seen[p*m + i];
+        ordered &= int64_t(i) > last[p];
+        last[p] = int64_t(i);
+      }
+    }
+    check("every item exactly once",
+          all_of(seen.begin(), seen.end(),
+                 [](size_t _s) { return _s == 1; }));
+    check("items in order per producer", ordered);
+  }
+
+  // Throughput, million items per second with nt producers and nt consumers
+  bench::options opt;
+  opt.min_samples = 3;
+  const uint64_t sum = uint64_t(N)*(N - 1)/2;
+  bool sums = true;
+  auto rate = [&opt, &sums, sum](auto _f) {
+    return N/bench::run("", [&]() {
+      uint64_t s = _f();
+      sums &= s == sum;
+      return s;
+    }, opt).median/1e6;
+  };
+
+  cout << endl << fixed << setprecision(1);
+  cout << setw(8) << "nt" << setw(12) << "locked" << setw(12) << "mpmc"
+       << setw(12) << "mpmc-bulk" << endl;
+  for(size_t nt = 1; nt <= MAX_N_THREADS; nt *= 2) {
+    locked_queue<uint64_t> lq(CAPACITY);
+    mpmc_queue<uint64_t> q(CAPACITY);
+    cout << setw(8) << nt
+         << setw(12) << rate([&]() { return stream(lq, nt, nt); })
+         << setw(12) << rate([&]() { return stream(q, nt, nt); })
+         << setw(12) << rate([&]() { return stream_bulk(q, nt, nt); })
+         << endl;
+  }
+  check("all streamed items received", sums);
+
+  return check.status();
+}
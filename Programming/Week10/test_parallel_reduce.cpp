@@ -0,0 +1,158 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Testing/timing of the generic parallel reduction.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "benchmark.h"
+#include "parallel_reduce.h"
+#include "rng.h"
+#include "test_check.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+using namespace std;
+
+constexpr size_t MAX_N_THREADS = 64; ///< Max threads in experiment
+constexpr size_t N = 1 << 24;        ///< Elements of the timed sums
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Main driver
+/// @return Success/Failure
+int
+main() {
+  checks check;
+  thread_pool pool(4);
+
+  // Integral sums are exact, whatever the partitioning
+  {
+    vector<int64_t> v(1'000'003);
+    iota(v.begin(), v.end(), -500'000);
+    int64_t ref = accumulate(v.begin(), v.end(), int64_t(7));
+    bool exact = true;
+    for(size_t nt : {1, 2, 3, 8, 64})
+      exact &= parallel::parallel_reduce(v.begin(), v.end(), int64_t(7),
+                                         parallel::async_policy{nt}) == ref;
+    exact &= parallel::parallel_reduce(v.begin(), v.end(), int64_t(7),
+                                       parallel::seq) == ref;
+    exact &= parallel::parallel_reduce(v.begin(), v.end(), int64_t(7),
+                                       parallel::par(pool)) == ref;
+    exact &= parallel::parallel_reduce(v.begin(), v.begin() + 5, int64_t(7),
+                                       parallel::par(pool)) ==
+             accumulate(v.begin(), v.begin() + 5, int64_t(7));
+    exact &= parallel::parallel_reduce(v.begin(), v.begin(), int64_t(7),
+                                       parallel::par(pool)) == 7;
+    check("integral sums match std::accumulate", exact);
+  }
+
+  // Operations other than addition
+  {
+    vector<double> v(300'007);
+    rng::xoshiro256pp generator;
+    generator.fill(v.data(), v.size(), -1., 1.);
+    double mx = parallel::parallel_reduce(v.begin(), v.end(), -HUGE_VAL,
+      [](double _a, double _b) { return max(_a, _b); },
+      parallel::async_policy{4});
+    check("maximum", mx == *max_element(v.begin(), v.end()));
+
+    bool thrown = false;
+    try {
+      parallel::parallel_reduce(v.begin(), v.end(), 1., multiplies<>(),
+                                parallel::sequential_policy{summation::kahan});
+    }
+    catch(const invalid_argument&) {
+      thrown = true;
+    }
+    check("compensated product throws", thrown);
+  }
+
+  // Associative but not commutative: concatenation keeps the element order
+  {
+    vector<string> v(3*(size_t(1) << 14) + 5);
+    for(size_t i = 0; i < v.size(); ++i)
+      v[i] = string(1, char('a' + i%26));
+    const string ref = accumulate(v.begin(), v.end(), string("<"));
+    bool ordered = parallel::parallel_reduce(v.begin(), v.end(), string("<"),
+                                             plus<>(), parallel::seq) == ref;
+    for(size_t nt : {1, 2, 4})
+      ordered &= parallel::parallel_reduce(v.begin(), v.end(), string("<"),
+                                           plus<>(),
+                                           parallel::async_policy{nt}) == ref;
+    ordered &= parallel::parallel_reduce(v.begin(), v.end(), string("<"),
+                                         plus<>(), parallel::par(pool)) == ref;
+    ordered &= parallel::parallel_reduce(v.begin(), v.begin() + 37,
+                                         string("<"), plus<>(),
+                                         parallel::seq) ==
+               accumulate(v.begin(), v.begin() + 37, string("<"));
+    check("concatenation keeps the order", ordered);
+  }
+
+  // Ill-conditioned sum: every third value is 1, the others 1e-10, whose
+  // additions to a large running sum round away most of their bits
+  {
+    const size_t n = 1'000'000;
+    vector<double> v(n);
+    size_t n_ones = 0;
+    for(size_t i = 0; i < n; ++i) {
+      v[i] = i%3 ? 1e-10 : 1.;
+      n_ones += i%3 == 0;
+    }
+    const double exact = double((long double)n_ones +
+                                (long double)(n - n_ones)*1e-10);
+    cout << scientific << setprecision(3);
+    cout << setw(12) << "mode" << setw(12) << "seq" << setw(12) << "par"
+         << endl;
+    double err[3][2];
+    const pair<const char*, summation> ms[] = {
+      {"plain", summation::plain}, {"kahan", summation::kahan},
+      {"pairwise", summation::pairwise}};
+    for(size_t m = 0; m < 3; ++m) {
+      err[m][0] = abs(parallel::parallel_reduce(
+        v.begin(), v.end(), 0., parallel::sequential_policy{ms[m].second}) -
+        exact)/exact;
+      err[m][1] = abs(parallel::parallel_reduce(
+        v.begin(), v.end(), 0., parallel::par(pool, ms[m].second)) -
+        exact)/exact;
+      cout << setw(12) << ms[m].first << setw(12) << err[m][0] << setw(12)
+           << err[m][1] << endl;
+    }
+    cout << fixed;
+    check("kahan sum is exact to double precision",
+          err[1][0] < 1e-15 && err[1][1] < 1e-15);
+    check("pairwise beats plain", err[2][0] < err[0][0]);
+  }
+
+  // Timing, million elements per second
+  vector<double> v(N);
+  rng::xoshiro256pp generator;
+  generator.fill(v.data(), v.size(), -1., 1.);
+  auto rate = [](auto _f) { return N/bench::run("", _f).median/1e6; };
+
+  cout << endl << setprecision(1);
+  cout << setw(20) << "std::accumulate" << setw(12)
+       << rate([&v]() { return accumulate(v.begin(), v.end(), 0.); }) << endl;
+  cout << setw(20) << "std::reduce" << setw(12)
+       << rate([&v]() { return reduce(v.begin(), v.end(), 0.); }) << endl
+       << endl;
+
+  cout << setw(8) << "nt" << setw(12) << "plain" << setw(12) << "kahan"
+       << setw(12) << "pairwise" << endl;
+  for(size_t nt = 1; nt <= MAX_N_THREADS; nt *= 2) {
+    cout << setw(8) << nt;
+    for(summation m : {summation::plain, summation::kahan,
+                       summation::pairwise})
+      cout << setw(12) << rate([&v, nt, m]() {
+        return parallel::parallel_reduce(v.begin(), v.end(), 0.,
+                                         parallel::async_policy{nt, m});
+      });
+    cout << endl;
+  }
+
+  return check.status();
+}
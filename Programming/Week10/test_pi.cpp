@@ -3,18 +3,42 @@
 /// @brief Timing/testing of sequential and parallel algorithms to compute pi.
 ////////////////////////////////////////////////////////////////////////////////
 
+#include "affinity.h"
+#include "anytime_pi.h"
+#include "async_pi.h"
+#include "autotune.h"
+#include "benchmark.h"
+#include "deterministic_pi.h"
+#include "mc_integrate.h"
 #include "parallel_pi.h"
+#include "perf_counters.h"
+#include "rng.h"
 #include "sequential_pi.h"
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <vector>
 using namespace std;
 
 constexpr size_t MAX_N_THREADS = 128; ///< Num threads in experiment
 constexpr size_t MAX_N = 256*256*256; ///< Max N in expeiriment 2^8*2^8*2^8 = 2^24
-constexpr size_t LINE_LEN = 116;      ///< Helper for output
+constexpr size_t LINE_LEN = 128;      ///< Helper for output
+
+vector<bench::result> results; ///< Every timed benchmark, for CSV/JSON output
+bool count_events = false;     ///< Also measure hardware counters per cell
+bool retune = false;           ///< Recalibrate the auto-tuner
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Helper to print a line of characters
@@ -27,42 +51,158 @@ print_line(char _c) {
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Time a function for a specific size n
+/// @brief Benchmark a function and record the result
+/// @param _name Benchmark name, unique within the run
 /// @param _f Function
-/// @param _n Number
-/// @return Average time to execute @c _f on size of @c _n
+/// @return Median time to execute @c _f
 float
-time_func(auto _f, size_t _n) {
-  using my_clock = chrono::high_resolution_clock;
-  using seconds = chrono::duration<float>;
+time_func(const string& _name, auto _f) {
+  results.emplace_back(bench::run(_name, _f));
+  return results.back().median;
+}
 
-  my_clock::time_point start = my_clock::now();
-  size_t r = max(MAX_N / 256 / _n, 10ul);
-  for(size_t i = 0; i < r; ++i) {
-    _f();
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Throughput of uniform doubles from one engine
+/// @tparam Engine Random number engine
+/// @param _name Engine name
+template<typename Engine>
+void
+time_engine(const char* _name) {
+  vector<double> buf(1 << 16);
+  Engine generator = rng::stream<Engine>(0, 0);
+  float t = time_func(string("engine/") + _name, [&buf, &generator]() {
+    if constexpr(requires { generator.fill(buf.data(), buf.size()); })
+      generator.fill(buf.data(), buf.size());
+    else {
+      uniform_real_distribution<double> distribution(0., 1.);
+      for(auto& x : buf)
+        x = distribution(generator);
+    }
+    bench::do_not_optimize(buf.front());
+  });
+  cout << setw(24) << _name << setw(12) << buf.size()/t/1e6 << endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Throughput and error of the double and fixed-point kernels
+void
+sampling_kernels() {
+  print_line('%');
+  cout << "Sampling kernels, pi(" << MAX_N << ") (million samples/s)" << endl;
+  print_line('%');
+  cout << endl;
+
+  cout << setw(8) << "isa" << setw(12) << "double" << setw(12) << "integer"
+       << setw(12) << "speedup" << setw(12) << "|err| dbl" << setw(12)
+       << "|err| int" << endl;
+  print_line('-');
+  for(simd::isa i : {simd::isa::scalar, simd::isa::sse2, simd::isa::avx2,
+                     simd::isa::avx512}) {
+    if(!simd::supported(i))
+      continue;
+    auto dbl = [i]() {
+      simd::lanes st = simd::seed(0);
+      return 4.*simd::count_inner(st, MAX_N, i)/MAX_N;
+    };
+    auto itg = [i]() {
+      simd::lanes st = simd::seed(0);
+      return 4.*simd::count_inner_int(st, MAX_N, i)/MAX_N;
+    };
+    string name = string("kernel/") + simd::name(i);
+    float t_dbl = time_func(name + "/double", dbl);
+    float t_int = time_func(name + "/integer", itg);
+    cout << setw(8) << simd::name(i) << setprecision(2)
+         << setw(12) << MAX_N/t_dbl/1e6
+         << setw(12) << MAX_N/t_int/1e6 << setw(12) << t_dbl/t_int
+         << scientific << setprecision(3)
+         << setw(12) << abs(dbl() - M_PI) << setw(12) << abs(itg() - M_PI)
+         << fixed << setprecision(7) << endl;
   }
+  cout << endl;
+}
 
-  return chrono::duration_cast<seconds>(
-    my_clock::now() - start
-  ).count()/(float(r));
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Count hardware events over the calls of the last benchmark
+/// @param _tids Threads running the benchmark besides the calling thread
+/// @param _f Function of the last benchmark
+/// @return Counts of one batch of calls and the number of calls
+pair<perf::sample, size_t>
+count_func(const vector<int>& _tids, auto _f) {
+  size_t calls = results.back().batch;
+  perf::sample s = perf::measure(_tids, [&_f, calls]() {
+    for(size_t i = 0; i < calls; ++i)
+      bench::do_not_optimize(_f());
+  });
+  return {s, calls};
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Main driver
-/// @return Success/Failure
-int
-main() {
+/// @brief Print derived counter metrics of a sweep, one table per metric
+/// @param _counts Counts and calls per row (n) and column (sq-*, nt)
+void
+print_counts(const vector<vector<pair<perf::sample, size_t>>>& _counts) {
+  using metric = pair<const char*, function<double(const perf::sample&,
+                                                   double, double)>>;
+  const metric ms[] = {
+    {"IPC", [](const perf::sample& _s, double, double) { return _s.ipc(); }},
+    {"branch-misses per sample", [](const perf::sample& _s, double _n,
+                                    double) {
+      return _s.per(perf::event::branch_misses, _n);
+    }},
+    {"L1d-misses per sample", [](const perf::sample& _s, double _n, double) {
+      return _s.per(perf::event::l1d_misses, _n);
+    }},
+    {"LLC-misses per sample", [](const perf::sample& _s, double _n, double) {
+      return _s.per(perf::event::llc_misses, _n);
+    }},
+    {"context-switches per call", [](const perf::sample& _s, double,
+                                     double _calls) {
+      return _s.per(perf::event::context_switches, _calls);
+    }}
+  };
+
+  cout << setprecision(4);
+  for(const metric& m : ms) {
+    cout << m.first << endl;
+    print_line('-');
+    size_t n = 256;
+    for(const auto& row : _counts) {
+      cout << setw(8) << n;
+      for(const auto& [s, calls] : row) {
+        double v = m.second(s, double(n)*calls, double(calls));
+        if(isnan(v))
+          cout << setw(12) << "n/a";
+        else
+          cout << setw(12) << v;
+      }
+      cout << endl;
+      n *= 2;
+    }
+    cout << endl;
+  }
   cout << setprecision(7);
-  cout << fixed;
+}
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Time the sweep over n and number of threads
+/// @param _key Short name of the sweep, prefixes the benchmark names
+/// @param _title Title of the table
+/// @param _f Parallel function taking n and number of threads
+/// @param _tids Worker thread ids used for a number of threads, for counters
+void
+time_sweep(const string& _key, const char* _title, auto _f,
+           function<vector<int>(size_t)> _tids =
+             [](size_t) { return vector<int>{}; }) {
   // Header information
   print_line('%');
-  cout << "Approximating pi" << endl;
+  cout << _title << " (median seconds per call)" << endl;
   print_line('%');
   cout << endl;
 
   cout << setw(8) << "n\\nt";
   cout << setw(12) << "sq";
+  cout << setw(12) << "sq-simd";
+  cout << setw(12) << "sq-int";
   for(size_t nt = 1; nt <= MAX_N_THREADS; nt *= 2) {
     cout << setw(12) << nt;
   }
@@ -70,12 +210,580 @@ main() {
   print_line('-');
 
   // Time all possibilities
+  vector<vector<pair<perf::sample, size_t>>> counts;
   for(size_t n = 256; n <= MAX_N; n*=2) {
+    string cell = _key + "/n=" + to_string(n);
+    vector<pair<perf::sample, size_t>> row;
+    auto sq = [_n = n](){ return sequential::pi(_n); };
+    auto sq_simd = [_n = n](){ return sequential::pi(_n, sampler::simd); };
+    auto sq_int = [_n = n](){ return sequential::pi(_n, sampler::integer); };
     cout << setw(8) << n;
-    cout << setw(12) << time_func([_n = n](){ sequential::pi(_n); }, n);
+    cout << setw(12) << time_func(cell + "/sq", sq);
+    if(count_events)
+      row.push_back(count_func({}, sq));
+    cout << setw(12) << time_func(cell + "/sq-simd", sq_simd);
+    if(count_events)
+      row.push_back(count_func({}, sq_simd));
+    cout << setw(12) << time_func(cell + "/sq-int", sq_int);
+    if(count_events)
+      row.push_back(count_func({}, sq_int));
     for(size_t nt = 1; nt <= MAX_N_THREADS; nt *= 2) {
-      cout << setw(12) << time_func([_n = n, _nt = nt](){ parallel::pi(_n, _nt); }, n);
+      auto par = [&_f, _n = n, _nt = nt](){ return _f(_n, _nt); };
+      cout << setw(12) << time_func(cell + "/nt=" + to_string(nt), par);
+      if(count_events)
+        row.push_back(count_func(_tids(nt), par));
+    }
+    cout << endl;
+    counts.push_back(move(row));
+  }
+  cout << endl;
+
+  if(count_events)
+    print_counts(counts);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Error versus time of all estimators
+/// @param _pool Pool running the estimators
+void
+error_vs_time(thread_pool& _pool) {
+  const pair<const char*, estimator> es[] = {
+    {"uniform", estimator::uniform},
+    {"halton", estimator::halton},
+    {"sobol", estimator::sobol},
+    {"stratified", estimator::stratified},
+    {"antithetic", estimator::antithetic}
+  };
+
+  print_line('%');
+  cout << "Estimators, |error| and time on " << _pool.size() << " threads"
+       << endl;
+  print_line('%');
+  cout << endl;
+
+  cout << setw(8) << "n";
+  for(auto& e : es)
+    cout << setw(12) << e.first << setw(12) << "time";
+  cout << endl;
+  print_line('-');
+
+  cout << scientific << setprecision(3);
+  for(size_t n = 256; n <= MAX_N; n *= 4) {
+    cout << setw(8) << n;
+    for(auto& e : es) {
+      double err = abs(parallel::pi(n, _pool.size(), _pool, e.second) - M_PI);
+      cout << setw(12) << err;
+      string name = string("estimator/") + e.first + "/n=" + to_string(n);
+      cout << setw(12) << time_func(name, [&_pool, _n = n, _e = e.second](){
+        return parallel::pi(_n, _pool.size(), _pool, _e);
+      });
     }
     cout << endl;
   }
-}
\ No newline at end of file
+  cout << fixed << setprecision(7) << endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Anytime estimation to decreasing tolerances
+/// @param _pool Pool running the parallel estimation
+void
+anytime(thread_pool& _pool) {
+  using my_clock = chrono::steady_clock;
+  using seconds = chrono::duration<float>;
+
+  print_line('%');
+  cout << "Anytime pi, 95% confidence interval, 1s budget" << endl;
+  print_line('%');
+  cout << endl;
+
+  cout << setw(12) << "tolerance" << setw(8) << "nt" << setw(12) << "n"
+       << setw(12) << "pi" << setw(12) << "+/-" << setw(12) << "time" << endl;
+  print_line('-');
+
+  for(double tol : {1e-2, 1e-3, 1e-4}) {
+    stop_rule rule;
+    rule.tolerance = tol;
+    for(size_t nt : {size_t(1), _pool.size()}) {
+      my_clock::time_point start = my_clock::now();
+      pi_estimate e = nt == 1 ? sequential::anytime_pi(rule)
+                              : parallel::anytime_pi(rule, nt, _pool);
+      float t = chrono::duration_cast<seconds>(my_clock::now() - start).count();
+      cout << setw(12) << tol << setw(8) << nt << setw(12) << e.n
+           << setw(12) << e.value() << setw(12) << e.half_width(rule.z)
+           << setw(12) << t << endl;
+    }
+  }
+  cout << endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Consume an asynchronous estimation
+/// @param _g Running estimates
+/// @param _stop Stop requested after @c _after estimates, if not null
+/// @param _after Number of estimates before stopping
+/// @return Last estimate
+coro::task<pi_estimate>
+last_estimate(coro::async_generator<pi_estimate> _g,
+              stop_source* _stop = nullptr, size_t _after = 0) {
+  pi_estimate last;
+  size_t k = 0;
+  while(optional<pi_estimate> e = co_await _g.next()) {
+    last = *e;
+    if(_stop && ++k == _after)
+      _stop->request_stop();
+  }
+  co_return last;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Many overlapping asynchronous estimations started from one thread
+/// @param _pool Pool executing all of them
+/// @return True if all final estimates equal reproducible_pi
+bool
+async_estimations(thread_pool& _pool) {
+  using my_clock = chrono::steady_clock;
+  using seconds = chrono::duration<float>;
+  constexpr size_t n_calls = 16;
+
+  print_line('%');
+  cout << "Asynchronous pi, " << n_calls << " overlapping calls of n = "
+       << MAX_N << " on " << _pool.size() << " threads" << endl;
+  print_line('%');
+  cout << endl;
+
+  my_clock::time_point start = my_clock::now();
+  vector<future<pi_estimate>> fts;
+  for(size_t i = 0; i < n_calls; ++i)
+    fts.emplace_back(coro::spawn(last_estimate(async_pi(MAX_N, _pool))));
+  double pi_ref = sequential::reproducible_pi(MAX_N);
+  bool identical = true;
+  for(auto& ft : fts)
+    identical &= ft.get().value() == pi_ref;
+  float t_async = chrono::duration_cast<seconds>(my_clock::now() - start)
+                    .count();
+
+  start = my_clock::now();
+  for(size_t i = 0; i < n_calls; ++i)
+    bench::do_not_optimize(
+      parallel::reproducible_pi(MAX_N, _pool.size(), _pool));
+  float t_blocking = chrono::duration_cast<seconds>(my_clock::now() - start)
+                       .count();
+
+  cout << setw(24) << "async (overlapped)" << setw(12) << t_async << endl;
+  cout << setw(24) << "blocking (one by one)" << setw(12) << t_blocking
+       << endl;
+  cout << "Final estimates " << (identical ? "identical" : "NOT identical")
+       << " to reproducible_pi" << endl;
+
+  stop_source stop;
+  pi_estimate e = coro::sync_wait(
+    last_estimate(async_pi(MAX_N, _pool, stop.get_token()), &stop, 2));
+  cout << "Cancelled after 2 chunks: n = " << e.n << ", pi = " << e.value()
+       << endl << endl;
+  return identical;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Auto-tuned pi against fixed configurations
+/// @param _pool Pool the tuner runs on
+void
+autotuned(thread_pool& _pool) {
+  autotuner tuner(_pool);
+  if(retune || tuner.table().empty())
+    tuner.calibrate();
+
+  print_line('%');
+  cout << "Auto-tuned pi on up to " << _pool.size() << " threads, table in "
+       << autotuner::default_cache() << endl;
+  print_line('%');
+  cout << endl;
+
+  cout << setw(8) << "n" << setw(12) << "threads" << setw(12) << "chunk"
+       << setw(12) << "auto" << setw(12) << "sq-simd" << setw(12)
+       << "pool-simd" << endl;
+  print_line('-');
+  for(size_t n = 256; n <= MAX_N; n *= 4) {
+    string cell = "autotune/n=" + to_string(n);
+    tuned_config c = tuner.choose(n);
+    cout << setw(8) << n << setw(12) << c.threads << setw(12) << c.chunk;
+    cout << setw(12) << time_func(cell + "/auto",
+      [&tuner, _n = n](){ return tuner.pi(_n); });
+    cout << setw(12) << time_func(cell + "/sq-simd",
+      [_n = n](){ return sequential::pi(_n, sampler::simd); });
+    cout << setw(12) << time_func(cell + "/pool-simd",
+      [&_pool, _n = n](){
+        return parallel::pi(_n, _pool.size(), _pool, sampler::simd);
+      });
+    cout << endl;
+  }
+  cout << endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Per-worker statistics of the work-stealing pool
+/// @param _pool Work-stealing pool
+void
+work_stealing_stats(work_stealing_pool& _pool) {
+  print_line('%');
+  cout << "Work stealing, pi(" << MAX_N << ") on " << _pool.size()
+       << " workers, 10 calls" << endl;
+  print_line('%');
+  cout << endl;
+
+  _pool.reset_stats();
+  for(size_t r = 0; r < 10; ++r)
+    bench::do_not_optimize(parallel::reproducible_pi(MAX_N, _pool));
+
+  cout << setw(8) << "worker" << setw(12) << "chunks" << setw(12) << "steals"
+       << setw(12) << "idle" << endl;
+  print_line('-');
+  vector<work_stealing_pool::worker_stats> st = _pool.stats();
+  for(size_t w = 0; w < st.size(); ++w)
+    cout << setw(8) << w << setw(12) << st[w].executed << setw(12)
+         << st[w].steals << setw(12) << st[w].idle.count() << endl;
+  cout << endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Generic integration engine under each policy
+/// @param _pool Pool for the thread pool policies
+///
+/// Integrates the pi indicator in 2D and the indicator of the unit ball in 4D
+/// (volume pi^2/2), checking that the pool policies match the sequential ones.
+/// @return True if the pool policies match the sequential ones
+bool
+integration(thread_pool& _pool) {
+  print_line('%');
+  cout << "mc_integrate, n = " << MAX_N << " on " << _pool.size()
+       << " threads" << endl;
+  print_line('%');
+  cout << endl;
+
+  cout << setw(8) << "problem" << setw(12) << "policy" << setw(16) << "value"
+       << setw(16) << "std error" << setw(16) << "|error|" << setw(12)
+       << "time" << endl;
+  print_line('-');
+
+  auto ball4 = [](const mc::point<4>& _x) {
+    return _x[0]*_x[0] + _x[1]*_x[1] + _x[2]*_x[2] + _x[3]*_x[3] < 1. ? 1. : 0.;
+  };
+  const mc::domain<4> cube{{-1., -1., -1., -1.}, {1., 1., 1., 1.}};
+
+  auto row = [](const char* _problem, const char* _policy, double _exact,
+                auto _f) {
+    mc::result r = _f();
+    string name = string("mc/") + _problem + "/" + _policy;
+    cout << setw(8) << _problem << setw(12) << _policy << setw(16) << r.value
+         << setw(16) << r.std_error << setw(16) << abs(r.value - _exact)
+         << setw(12) << time_func(name, _f) << endl;
+    return r.value;
+  };
+
+  bool identical = true;
+  for(bool vec : {false, true}) {
+    double s = row("pi", vec ? "seq-simd" : "seq", M_PI, [vec]() {
+      return mc::pi(MAX_N, mc::sequential_policy{vec});
+    });
+    identical &= s == row("pi", vec ? "pool-simd" : "pool", M_PI,
+                          [&_pool, vec]() {
+      return mc::pi(MAX_N, mc::par(_pool, vec));
+    });
+  }
+  for(bool vec : {false, true}) {
+    double s = row("ball4", vec ? "seq-simd" : "seq", M_PI*M_PI/2,
+                   [&ball4, &cube, vec]() {
+      return mc::mc_integrate(ball4, cube, MAX_N, mc::sequential_policy{vec});
+    });
+    identical &= s == row("ball4", vec ? "pool-simd" : "pool", M_PI*M_PI/2,
+                          [&_pool, &ball4, &cube, vec]() {
+      return mc::mc_integrate(ball4, cube, MAX_N, mc::par(_pool, vec));
+    });
+  }
+  cout << "Pool policies " << (identical ? "identical" : "NOT identical")
+       << " to sequential" << endl << endl;
+  return identical;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Digits per second of the deterministic Chudnovsky engine
+/// @return True if all digit and thread counts agree with the reference
+bool
+digits_per_second() {
+  constexpr size_t MAX_DIGITS = 100'000;
+  const string pi_50 = "3.14159265358979323846264338327950288419716939937510";
+  const size_t nt = max<size_t>(2, thread_pool::default_size());
+  const string ref = deterministic::pi(MAX_DIGITS, nt);
+  bool ok = ref.compare(0, pi_50.size(), pi_50) == 0;
+
+  print_line('%');
+  cout << "Deterministic pi (Chudnovsky, binary splitting), digits per second"
+       << endl;
+  print_line('%');
+  cout << endl;
+
+  cout << setw(8) << "digits" << setw(12) << "nt=1" << setw(12)
+       << "nt=" + to_string(nt) << setw(12) << "speedup" << endl;
+  print_line('-');
+
+  bench::options opt;
+  opt.min_samples = 3;
+  cout << setprecision(0);
+  for(size_t d = 100; d <= MAX_DIGITS; d *= 10) {
+    string cell = "digits/d=" + to_string(d);
+    double t[2];
+    for(size_t i : {0, 1}) {
+      size_t k = i ? nt : 1;
+      results.emplace_back(bench::run(cell + "/nt=" + to_string(k),
+        [_d = d, k](){ return deterministic::pi(_d, k); }, opt));
+      t[i] = results.back().median;
+      ok &= deterministic::pi(d, k) == ref.substr(0, d + 2);
+    }
+    cout << setw(8) << d << setw(12) << d/t[0] << setw(12) << d/t[1]
+         << setw(12) << setprecision(2) << t[0]/t[1] << setprecision(0)
+         << endl;
+  }
+  cout << setprecision(7) << endl;
+  cout << "Digits " << (ok ? "agree" : "DO NOT agree") << " with pi("
+       << MAX_DIGITS << ") and its first 50 digits" << endl << endl;
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Machine readable output and comparison against a saved baseline
+/// @param _csv CSV file, skipped if empty
+/// @param _json JSON file, skipped if empty
+/// @param _baseline Baseline CSV file, skipped if empty
+/// @param _threshold Relative change reported as a regression/improvement
+/// @return Failure if the baseline is missing or a benchmark regressed
+int
+report(const string& _csv, const string& _json, const string& _baseline,
+       double _threshold) {
+  if(!_csv.empty()) {
+    ofstream ofs(_csv);
+    bench::write_csv(ofs, results);
+  }
+  if(!_json.empty()) {
+    ofstream ofs(_json);
+    bench::write_json(ofs, results);
+  }
+  if(!_baseline.empty()) {
+    ifstream ifs(_baseline);
+    if(!ifs) {
+      cerr << "Cannot read baseline " << _baseline << endl;
+      return 1;
+    }
+    size_t n_regressions = 0, n_compared = 0;
+    cout << endl << setprecision(3) << scientific;
+    for(const bench::comparison& c :
+        bench::compare(results, bench::read_csv(ifs), _threshold)) {
+      ++n_compared;
+      if(!c.regression && !c.improvement)
+        continue;
+      n_regressions += c.regression;
+      cout << (c.regression ? "REGRESSION  " : "IMPROVEMENT ")
+           << setw(40) << left << c.name << right
+           << setw(12) << c.baseline << setw(12) << c.current
+           << setw(8) << fixed << setprecision(2) << c.current/c.baseline
+           << "x" << scientific << setprecision(3) << endl;
+    }
+    cout << n_regressions << " regressions in " << n_compared
+         << " benchmarks compared" << endl;
+    return n_regressions > 0;
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Print the command line options
+/// @param _prog Program name
+void
+usage(const char* _prog) {
+  cerr << "Usage: " << _prog << " [--csv file] [--json file] [--baseline file]"
+       << " [--threshold fraction]\n"
+       << "  [--placement none|compact|scatter|physical] [--perf] [--retune]"
+       << " [--digits]" << endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parse a non-negative fraction
+/// @param _s Text, a number and nothing else
+/// @return Fraction, empty if @c _s is not one
+optional<double>
+parse_fraction(const char* _s) {
+  char* end = nullptr;
+  double x = strtod(_s, &end);
+  if(end == _s || *end || !isfinite(x) || x < 0)
+    return nullopt;
+  return x;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Main driver
+/// @param argc Number of arguments
+/// @param argv Arguments: [--csv file] [--json file] [--baseline file]
+///             [--threshold fraction]
+///             [--placement none|compact|scatter|physical] [--perf]
+///             [--retune] [--digits]
+/// @return Success/Failure, failure if a regression against the baseline or
+///         a failed consistency check
+///
+/// With --digits only the deterministic engine is timed.
+int
+main(int argc, char** argv) {
+  string csv, json, baseline;
+  double threshold = 0.05;
+  placement where = placement::none;
+  bool digits = false;
+  for(int i = 1; i < argc; ++i) {
+    auto value = [&i, argc, argv]() -> const char* {
+      return i + 1 < argc ? argv[++i] : nullptr;
+    };
+    const char* v = nullptr;
+    optional<double> t;
+    optional<placement> p;
+    if(!strcmp(argv[i], "--perf"))
+      count_events = true;
+    else if(!strcmp(argv[i], "--retune"))
+      retune = true;
+    else if(!strcmp(argv[i], "--digits"))
+      digits = true;
+    else if(!strcmp(argv[i], "--csv") && (v = value()))
+      csv = v;
+    else if(!strcmp(argv[i], "--json") && (v = value()))
+      json = v;
+    else if(!strcmp(argv[i], "--baseline") && (v = value()))
+      baseline = v;
+    else if(!strcmp(argv[i], "--threshold") && (v = value()) &&
+            (t = parse_fraction(v)))
+      threshold = *t;
+    else if(!strcmp(argv[i], "--placement") && (v = value()) &&
+            (p = affinity::parse(v)))
+      where = *p;
+    else {
+      cerr << "Unknown option, missing or bad value: " << argv[i] << endl;
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  cout << setprecision(7);
+  cout << fixed;
+
+  if(digits) {
+    bool ok = digits_per_second();
+    return report(csv, json, baseline, threshold) || !ok;
+  }
+
+  cout << "SIMD kernel: " << simd::name(simd::best_isa()) << endl;
+
+  // Pools pin their workers; std::async threads are never pinned
+  affinity::topology topo = affinity::detect();
+  cout << "Topology: " << affinity::describe(topo) << endl;
+  cout << "Placement: " << affinity::name(where);
+  if(where != placement::none) {
+    vector<int> cpus = affinity::plan(topo, where, MAX_N_THREADS);
+    cout << ", workers 0.." << MAX_N_THREADS - 1 << " on cpus";
+    for(size_t i = 0; i < min<size_t>(16, cpus.size()); ++i)
+      cout << " " << cpus[i];
+    if(cpus.size() > 16)
+      cout << " ...";
+  }
+  cout << endl;
+
+  if(count_events && !perf::counters().available()) {
+    cout << "Performance counters unavailable (perf_event_open failed)"
+         << endl;
+    count_events = false;
+  }
+  cout << endl;
+
+  print_line('%');
+  cout << "Random engine throughput (million doubles/s)" << endl;
+  print_line('%');
+  time_engine<default_random_engine>("default_random_engine");
+  time_engine<mt19937_64>("mt19937_64");
+  time_engine<rng::xoshiro256pp>("xoshiro256++");
+  time_engine<rng::philox4x32>("philox4x32");
+  cout << endl;
+
+  sampling_kernels();
+
+  time_sweep("async", "Approximating pi (std::async)",
+    [](size_t _n, size_t _nt){ return parallel::pi(_n, _nt); }
+  );
+
+  time_sweep("async-simd", "Approximating pi (std::async, simd)",
+    [](size_t _n, size_t _nt){ return parallel::pi(_n, _nt, sampler::simd); }
+  );
+
+  time_sweep("async-int", "Approximating pi (std::async, integer)",
+    [](size_t _n, size_t _nt){
+      return parallel::pi(_n, _nt, sampler::integer);
+    }
+  );
+
+  // One pool per thread count, created before timing so repeated calls never
+  // create threads. Index is log2 of the pool size.
+  vector<unique_ptr<thread_pool>> pools;
+  for(size_t nt = 1; nt <= MAX_N_THREADS; nt *= 2)
+    pools.emplace_back(make_unique<thread_pool>(nt, where));
+
+  time_sweep("pool", "Approximating pi (thread_pool)",
+    [&pools](size_t _n, size_t _nt){
+      return parallel::pi(_n, _nt, *pools[__builtin_ctzl(_nt)]);
+    },
+    [&pools](size_t _nt){ return pools[__builtin_ctzl(_nt)]->tids(); }
+  );
+
+  time_sweep("pool-xoshiro", "Approximating pi (thread_pool, xoshiro256++)",
+    [&pools](size_t _n, size_t _nt){
+      return parallel::pi<rng::xoshiro256pp>(_n, _nt,
+                                             *pools[__builtin_ctzl(_nt)]);
+    },
+    [&pools](size_t _nt){ return pools[__builtin_ctzl(_nt)]->tids(); }
+  );
+
+  time_sweep("reproducible", "Approximating pi (thread_pool, reproducible)",
+    [&pools](size_t _n, size_t _nt){
+      return parallel::reproducible_pi(_n, _nt, *pools[__builtin_ctzl(_nt)]);
+    },
+    [&pools](size_t _nt){ return pools[__builtin_ctzl(_nt)]->tids(); }
+  );
+
+  vector<unique_ptr<work_stealing_pool>> ws_pools;
+  for(size_t nt = 1; nt <= MAX_N_THREADS; nt *= 2)
+    ws_pools.emplace_back(make_unique<work_stealing_pool>(nt, where));
+
+  time_sweep("work-stealing",
+    "Approximating pi (work_stealing_pool, reproducible)",
+    [&ws_pools](size_t _n, size_t _nt){
+      return parallel::reproducible_pi(_n, *ws_pools[__builtin_ctzl(_nt)]);
+    },
+    [&ws_pools](size_t _nt){ return ws_pools[__builtin_ctzl(_nt)]->tids(); }
+  );
+
+  work_stealing_pool ws_pool(thread_pool::default_size(), where);
+  work_stealing_stats(ws_pool);
+
+  thread_pool pool(thread_pool::default_size(), where);
+  bool ok = true;
+  error_vs_time(pool);
+  anytime(pool);
+  ok &= async_estimations(pool);
+  autotuned(pool);
+  ok &= integration(pool);
+
+  // Reproducibility check, n is deliberately not a multiple of anything
+  constexpr size_t n_check = 1'000'003;
+  double pi_ref = sequential::reproducible_pi(n_check);
+  bool identical = true;
+  for(size_t nt = 1; nt <= MAX_N_THREADS; nt *= 2)
+    identical &= parallel::reproducible_pi(
+      n_check, nt, *pools[__builtin_ctzl(nt)]) == pi_ref;
+  cout << "Reproducible pi(" << n_check << ") = " << setprecision(15) << pi_ref
+       << (identical ? " identical" : " NOT identical")
+       << " for 1 to " << MAX_N_THREADS << " threads" << endl;
+  ok &= identical;
+
+  return report(csv, json, baseline, threshold) || !ok;
+}
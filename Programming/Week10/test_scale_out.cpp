@@ -0,0 +1,187 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Testing/timing of the multi-process scale-out of pi.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "scale_out.h"
+#include "sequential_pi.h"
+#include "test_check.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+using namespace std;
+
+constexpr size_t MAX_N_PROCS = 16;    ///< Max worker processes in experiment
+constexpr size_t N = 1 << 24;         ///< Samples per run
+constexpr size_t N_CHECK = 1'000'003; ///< Samples of the correctness checks
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Worker that dies abruptly after reporting a few blocks
+/// @param _fd Connected socket
+void
+faulty(int _fd) {
+  scale_out::lease_msg l;
+  size_t reported = 0;
+  while(scale_out::detail::recv_all(_fd, &l, sizeof(l)))
+    for(uint64_t b = l.begin; b < l.end; ++b) {
+      if(reported++ == 3)
+        ::_exit(1);
+      scale_out::report_msg r{b, sequential::count_block(l.n, b, l.seed)};
+      scale_out::detail::send_all(_fd, &r, sizeof(r));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Worker that hangs with its socket open after its first lease
+/// @param _fd Connected socket
+void
+stalled(int _fd) {
+  scale_out::lease_msg l;
+  if(scale_out::detail::recv_all(_fd, &l, sizeof(l)))
+    for(;;)
+      ::pause();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Worker that hangs with its socket open halfway through its first
+///        report
+/// @param _fd Connected socket
+void
+truncated(int _fd) {
+  scale_out::lease_msg l;
+  if(scale_out::detail::recv_all(_fd, &l, sizeof(l))) {
+    scale_out::report_msg r{l.begin, sequential::count_block(l.n, l.begin,
+                                                             l.seed)};
+    scale_out::detail::send_all(_fd, &r, sizeof(r)/2);
+    for(;;)
+      ::pause();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Main driver
+/// @return Success/Failure
+int
+main() {
+  using my_clock = chrono::steady_clock;
+  using seconds = chrono::duration<float>;
+
+  cout << setprecision(7) << fixed;
+  checks check;
+  const double ref = sequential::reproducible_pi(N_CHECK);
+
+  // Forked workers
+  {
+    scale_out::coordinator c(4);
+    c.spawn(4);
+    check("forked workers match reproducible_pi",
+          c.pi(N_CHECK) == ref);
+    check("coordinator is reusable", c.pi(N_CHECK) == ref);
+  }
+
+  // Workers dying mid-run, their blocks are leased again
+  {
+    scale_out::coordinator c(2);
+    c.spawn(2);
+    c.spawn(2, faulty);
+    double pi = c.pi(N_CHECK);
+    check("re-leasing after worker loss matches", pi == ref);
+    check("lost workers are detected",
+          c.stats().lost == 2 && c.size() == 2);
+    cout << "  leases " << c.stats().leases << ", blocks re-leased "
+         << c.stats().re_leased << endl;
+  }
+
+  // All workers dying is an error, not a hang
+  {
+    scale_out::coordinator c(2);
+    c.spawn(2, faulty);
+    bool thrown = false;
+    try {
+      c.pi(N_CHECK);
+    }
+    catch(const runtime_error&) {
+      thrown = true;
+    }
+    check("losing all workers throws", thrown);
+  }
+
+  // A hung worker misses its lease deadline, is killed, and its blocks are
+  // leased again; the destructor then reaps it without waiting
+  {
+    my_clock::time_point start = my_clock::now();
+    {
+      scale_out::coordinator c(2, chrono::milliseconds(200));
+      c.spawn(2);
+      c.spawn(1, stalled);
+      double pi = c.pi(N_CHECK);
+      check("re-leasing after a missed deadline matches", pi == ref);
+      check("stalled worker expires",
+            c.stats().expired == 1 && c.stats().lost == 1 &&
+            c.size() == 2);
+    }
+    float t = chrono::duration_cast<seconds>(my_clock::now() - start).count();
+    check("stalled worker does not block", t < 5);
+  }
+
+  // Same for a worker stalling in the middle of a report
+  {
+    my_clock::time_point start = my_clock::now();
+    {
+      scale_out::coordinator c(2, chrono::milliseconds(200));
+      c.spawn(2);
+      c.spawn(1, truncated);
+      double pi = c.pi(N_CHECK);
+      check("re-leasing after a partial report matches", pi == ref);
+      check("worker stalled mid-report expires",
+            c.stats().expired == 1 && c.stats().lost == 1 &&
+            c.size() == 2);
+    }
+    float t = chrono::duration_cast<seconds>(my_clock::now() - start).count();
+    check("partial report does not block", t < 5);
+  }
+
+  // Worker process behind a Unix-domain socket, as for a remote node
+  {
+    string path = "/tmp/pi_worker_" + to_string(::getpid()) + ".sock";
+    ::unlink(path.c_str());
+    pid_t pid = ::fork();
+    if(pid == 0) {
+      scale_out::serve_unix(path);
+      ::_exit(0);
+    }
+
+    // Retry until the worker listens
+    bool match = false;
+    {
+      scale_out::coordinator c;
+      for(size_t i = 0; i < 5000 && c.size() == 0; ++i) {
+        try {
+          c.connect(path);
+        }
+        catch(const runtime_error&) {
+          ::usleep(1000);
+        }
+      }
+      match = c.size() == 1 && c.pi(N_CHECK) == ref;
+    }
+    ::waitpid(pid, nullptr, 0);
+    check("Unix socket worker matches", match);
+  }
+
+  // Scaling with the number of processes
+  cout << endl << setw(8) << "procs" << setw(12) << "time" << setw(12)
+       << "pi" << endl;
+  for(size_t np = 1; np <= MAX_N_PROCS; np *= 2) {
+    scale_out::coordinator c;
+    c.spawn(np);
+    my_clock::time_point start = my_clock::now();
+    double pi = c.pi(N);
+    float t = chrono::duration_cast<seconds>(my_clock::now() - start).count();
+    cout << setw(8) << np << setw(12) << t << setw(12) << pi << endl;
+  }
+
+  return check.status();
+}
@@ -0,0 +1,209 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Testing/timing of the block-parallel scans.
+///
+/// Compile with -DWITH_PSTL (and -ltbb for libstdc++) to also time
+/// std::inclusive_scan under std::execution::par.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "benchmark.h"
+#include "parallel_scan.h"
+#include "rng.h"
+#include "test_check.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+#ifdef WITH_PSTL
+#include <execution>
+#endif
+using namespace std;
+
+constexpr size_t MAX_N_THREADS = 64; ///< Max threads in experiment
+constexpr size_t N = 1 << 24;        ///< Elements of the timed scans
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compare integer scans of one type against the standard scans
+/// @tparam T Integer type
+/// @param _pool Pool for the pool policy
+/// @return Whether all scans match exactly
+template<typename T>
+bool
+exact_scans(thread_pool& _pool) {
+  bool same = true;
+  for(size_t n : {0, 1, 7, 100, 3*(1 << 14) + 5, 1'000'003}) {
+    vector<T> v(n), ref(n), out(n);
+    for(size_t i = 0; i < n; ++i)
+      v[i] = T((i*2654435761u)%1000) - T(300);
+
+    auto test = [&](auto _p) {
+      inclusive_scan(v.begin(), v.end(), ref.begin());
+      parallel::parallel_inclusive_scan(v.begin(), v.end(), out.begin(), _p);
+      same &= out == ref;
+      exclusive_scan(v.begin(), v.end(), ref.begin(), T(5));
+      parallel::parallel_exclusive_scan(v.begin(), v.end(), out.begin(), T(5),
+                                        _p);
+      same &= out == ref;
+    };
+    test(parallel::seq);
+    for(size_t nt : {2, 3, 64})
+      test(parallel::async_policy{nt});
+    test(parallel::par(_pool));
+  }
+  return same;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Main driver
+/// @return Success/Failure
+int
+main() {
+  checks check;
+  thread_pool pool(4);
+
+  check("int64 scans match std", exact_scans<int64_t>(pool));
+  check("uint64 scans match std", exact_scans<uint64_t>(pool));
+  check("int32 scans match std", exact_scans<int32_t>(pool));
+  check("uint32 scans match std", exact_scans<uint32_t>(pool));
+
+  // In place, other operations, and iterators without contiguous storage
+  {
+    vector<int64_t> v(1'000'003);
+    iota(v.begin(), v.end(), -500'000);
+    vector<int64_t> ref(v.size());
+    inclusive_scan(v.begin(), v.end(), ref.begin());
+    parallel::parallel_inclusive_scan(v.begin(), v.end(), v.begin(),
+                                      parallel::async_policy{4});
+    check("in place", v == ref);
+
+    vector<double> x(300'007);
+    rng::xoshiro256pp generator;
+    generator.fill(x.data(), x.size(), -1., 1.);
+    vector<double> mref(x.size()), mout(x.size());
+    auto mx = [](double _a, double _b) { return max(_a, _b); };
+    inclusive_scan(x.begin(), x.end(), mref.begin(), mx);
+    parallel::parallel_inclusive_scan(x.begin(), x.end(), mout.begin(), mx,
+                                      parallel::async_policy{4});
+    check("running maximum", mout == mref);
+
+    deque<int64_t> d(v.begin(), v.begin() + 200'001);
+    deque<int64_t> dout(d.size());
+    vector<int64_t> dref(d.size());
+    exclusive_scan(d.begin(), d.end(), dref.begin(), int64_t(-1));
+    parallel::parallel_exclusive_scan(d.begin(), d.end(), dout.begin(),
+                                      int64_t(-1), parallel::par(pool));
+    check("deque", equal(dout.begin(), dout.end(), dref.begin()));
+  }
+
+  // Associative but not commutative: products of 2x2 matrices modulo 2^64,
+  // shears of determinant 1, so that long products do not collapse to 0
+  {
+    using mat = array<uint64_t, 4>;
+    auto mul = [](const mat& _a, const mat& _b) {
+      return mat{_a[0]*_b[0] + _a[1]*_b[2], _a[0]*_b[1] + _a[1]*_b[3],
+                 _a[2]*_b[0] + _a[3]*_b[2], _a[2]*_b[1] + _a[3]*_b[3]};
+    };
+    vector<mat> m(3*(size_t(1) << 14) + 5);
+    rng::xoshiro256pp generator;
+    for(auto& a : m) {
+      const uint64_t k = 1 + generator()%6;
+      a = generator()%2 ? mat{1, k, 0, 1} : mat{1, 0, k, 1};
+    }
+    vector<mat> iref(m.size()), eref(m.size()), out(m.size());
+    const mat id{1, 0, 0, 1};
+    inclusive_scan(m.begin(), m.end(), iref.begin(), mul);
+    exclusive_scan(m.begin(), m.end(), eref.begin(), id, mul);
+    bool ordered = true;
+    for(size_t nt : {1, 2, 4}) {
+      parallel::parallel_inclusive_scan(m.begin(), m.end(), out.begin(), mul,
+                                        parallel::async_policy{nt});
+      ordered &= out == iref;
+      parallel::parallel_exclusive_scan(m.begin(), m.end(), out.begin(), id,
+                                        mul, parallel::async_policy{nt});
+      ordered &= out == eref;
+    }
+    check("matrix products keep the order", ordered);
+  }
+
+  // Floating-point sums are regrouped, compare to a long double reference
+  {
+    vector<double> x(1'000'003);
+    rng::xoshiro256pp generator;
+    generator.fill(x.data(), x.size());
+    vector<double> out(x.size());
+    double err = 0;
+    for(size_t nt : {1, 4}) {
+      parallel::parallel_exclusive_scan(x.begin(), x.end(), out.begin(), 0.,
+                                        parallel::async_policy{nt});
+      long double s = 0;
+      for(size_t i = 0; i < x.size(); ++i) {
+        err = max(err, double(abs(out[i] - s)/max(s, 1.L)));
+        s += x[i];
+      }
+    }
+    check("double scan accurate", err < 1e-12);
+  }
+
+  // Timing, million elements per second
+  vector<double> x(N), y(N);
+  rng::xoshiro256pp generator;
+  generator.fill(x.data(), x.size());
+  vector<int64_t> k(N), l(N);
+  for(size_t i = 0; i < N; ++i)
+    k[i] = int64_t(i%7);
+  auto rate = [](auto _f) { return N/bench::run("", _f).median/1e6; };
+
+  cout << endl << fixed << setprecision(1);
+  cout << setw(28) << "" << setw(12) << "double" << setw(12) << "int64"
+       << endl;
+  cout << setw(28) << "std::inclusive_scan" << setw(12) << rate([&]() {
+    inclusive_scan(x.begin(), x.end(), y.begin());
+    return y.back();
+  }) << setw(12) << rate([&]() {
+    inclusive_scan(k.begin(), k.end(), l.begin());
+    return l.back();
+  }) << endl;
+#ifdef WITH_PSTL
+  cout << setw(28) << "std::inclusive_scan(par)" << setw(12) << rate([&]() {
+    inclusive_scan(execution::par, x.begin(), x.end(), y.begin());
+    return y.back();
+  }) << setw(12) << rate([&]() {
+    inclusive_scan(execution::par, k.begin(), k.end(), l.begin());
+    return l.back();
+  }) << endl;
+#endif
+  cout << setw(28) << "parallel_inclusive_scan(seq)" << setw(12)
+       << rate([&]() {
+    parallel::parallel_inclusive_scan(x.begin(), x.end(), y.begin(),
+                                      parallel::seq);
+    return y.back();
+  }) << setw(12) << rate([&]() {
+    parallel::parallel_inclusive_scan(k.begin(), k.end(), l.begin(),
+                                      parallel::seq);
+    return l.back();
+  }) << endl << endl;
+
+  cout << setw(8) << "nt" << setw(12) << "double" << setw(12) << "int64"
+       << endl;
+  for(size_t nt = 1; nt <= MAX_N_THREADS; nt *= 2) {
+    cout << setw(8) << nt << setw(12) << rate([&, nt]() {
+      parallel::parallel_inclusive_scan(x.begin(), x.end(), y.begin(),
+                                        parallel::async_policy{nt});
+      return y.back();
+    }) << setw(12) << rate([&, nt]() {
+      parallel::parallel_inclusive_scan(k.begin(), k.end(), l.begin(),
+                                        parallel::async_policy{nt});
+      return l.back();
+    }) << endl;
+  }
+
+  return check.status();
+}
@@ -0,0 +1,158 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Testing/timing of the quantile and cardinality sketches.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "benchmark.h"
+#include "parallel_reduce.h"
+#include "rng.h"
+#include "sketches.h"
+#include "test_check.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+constexpr size_t MAX_N_THREADS = 64; ///< Max threads in experiment
+constexpr size_t N = 1 << 22;        ///< Elements of the timed fills
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Largest rank error of a KLL sketch over a set of quantiles
+/// @param _s Sketch of the values
+/// @param _sorted Values, sorted
+/// @return Largest |exact rank of the estimated quantile - q|
+double
+rank_error(const sketch::kll<>& _s, const vector<double>& _sorted) {
+  double err = 0;
+  for(double q : {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99}) {
+    double x = _s.quantile(q);
+    double r = double(upper_bound(_sorted.begin(), _sorted.end(), x) -
+                      _sorted.begin())/_sorted.size();
+    err = max(err, abs(r - q));
+  }
+  return err;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Main driver
+/// @return Success/Failure
+int
+main() {
+  checks check;
+  thread_pool pool(4);
+  auto make_kll = [](size_t _i) { return sketch::kll<>(200, _i); };
+  auto make_hll = [](size_t) { return sketch::hyperloglog(14); };
+
+  // Quantiles of skewed data, sequential and merged from partitions
+  {
+    vector<double> v(2'000'003);
+    rng::xoshiro256pp generator;
+    generator.fill(v.data(), v.size());
+    for(double& x : v)
+      x = -log1p(-x);
+    vector<double> sorted = v;
+    sort(sorted.begin(), sorted.end());
+
+    sketch::kll<> s;
+    for(double x : v)
+      s.add(x);
+    double err = rank_error(s, sorted);
+    bool counted = true;
+    for(size_t nt : {2, 7, 64}) {
+      auto m = sketch::parallel_fill(v.begin(), v.end(), make_kll,
+                                     parallel::async_policy{nt});
+      err = max(err, rank_error(m, sorted));
+      counted &= m.count() == v.size();
+    }
+    auto m = sketch::parallel_fill(v.begin(), v.end(), make_kll,
+                                   parallel::par(pool));
+    err = max(err, rank_error(m, sorted));
+    check("KLL merged sketches count every sample", counted);
+    cout << "KLL rank error " << err << ", retained " << s.size() << " of "
+         << s.count() << endl;
+    check("KLL quantiles within 2% in rank", err < 0.02);
+    check("KLL memory bounded", s.size() < 4*s.k());
+    check("KLL rank of the median",
+          abs(s.rank(sorted[sorted.size()/2]) - 0.5) < 0.02);
+
+    bool thrown = false;
+    try {
+      s.merge(sketch::kll<>(100));
+    }
+    catch(const invalid_argument&) {
+      thrown = true;
+    }
+    check("KLL merge with other k throws", thrown);
+  }
+
+  // Distinct counts, every value occurring three times
+  {
+    bool close = true;
+    for(size_t n : {100, 10'000, 1'000'000}) {
+      vector<uint64_t> v(3*n);
+      for(size_t i = 0; i < v.size(); ++i)
+        v[i] = (i*2654435761u)%n;
+      double e = sketch::parallel_fill(v.begin(), v.end(), make_hll,
+                                       parallel::seq).estimate();
+      cout << "HLL " << n << " distinct, estimate " << e << endl;
+      close &= abs(e - double(n))/n < 4*1.04/128;
+    }
+    check("HLL estimates within four standard errors", close);
+
+    vector<uint64_t> v(1'000'000);
+    for(size_t i = 0; i < v.size(); ++i)
+      v[i] = i;
+    double ref = sketch::parallel_fill(v.begin(), v.end(), make_hll,
+                                       parallel::seq).estimate();
+    bool same = true;
+    for(size_t nt : {2, 7, 64})
+      same &= sketch::parallel_fill(v.begin(), v.end(), make_hll,
+                                    parallel::async_policy{nt}).estimate() ==
+              ref;
+    same &= sketch::parallel_fill(v.begin(), v.end(), make_hll,
+                                  parallel::par(pool)).estimate() == ref;
+    check("HLL independent of partitioning", same);
+
+    bool thrown = false;
+    try {
+      sketch::hyperloglog h(14);
+      h.merge(sketch::hyperloglog(12));
+    }
+    catch(const invalid_argument&) {
+      thrown = true;
+    }
+    check("HLL merge with other p throws", thrown);
+  }
+
+  // Timing, million elements per second
+  vector<double> v(N);
+  rng::xoshiro256pp generator;
+  generator.fill(v.data(), v.size());
+  auto rate = [](auto _f) { return N/bench::run("", _f).median/1e6; };
+
+  cout << endl << fixed << setprecision(1);
+  cout << setw(20) << "std::sort" << setw(12) << rate([&v]() {
+    vector<double> w = v;
+    sort(w.begin(), w.end());
+    return w[N/2];
+  }) << endl << endl;
+
+  cout << setw(8) << "nt" << setw(12) << "kll" << setw(12) << "hll" << endl;
+  for(size_t nt = 1; nt <= MAX_N_THREADS; nt *= 2) {
+    cout << setw(8) << nt << setw(12) << rate([&v, &make_kll, nt]() {
+      return sketch::parallel_fill(v.begin(), v.end(), make_kll,
+                                   parallel::async_policy{nt}).quantile(0.5);
+    }) << setw(12) << rate([&v, &make_hll, nt]() {
+      return sketch::parallel_fill(v.begin(), v.end(), make_hll,
+                                   parallel::async_policy{nt}).estimate();
+    }) << endl;
+  }
+
+  return check.status();
+}
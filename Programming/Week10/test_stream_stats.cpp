@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Testing/timing of streaming statistics over files of doubles.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "benchmark.h"
+#include "rng.h"
+#include "stream_stats.h"
+#include "test_check.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+constexpr size_t MAX_N_THREADS = 16;    ///< Max threads in experiment
+constexpr size_t N = 3*(1 << 24) + 123; ///< Values in the test file, ~400 MB
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Check whether two summaries agree bit for bit
+bool
+same(const streaming::summary& _a, const streaming::summary& _b) {
+  return _a.n == _b.n && _a.mean == _b.mean && _a.m2 == _b.m2 &&
+         _a.min == _b.min && _a.max == _b.max;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Main driver
+/// @param argc Number of arguments
+/// @param argv Arguments: [file], a file of doubles to summarize instead of
+///             the generated one
+/// @return Success/Failure
+int
+main(int argc, char** argv) {
+  checks check;
+  string path = "/tmp/stream_stats_" + to_string(::getpid()) + ".bin";
+
+  // Values with a large offset, where the naive sum of squares cancels
+  vector<double> v(N);
+  rng::xoshiro256pp generator;
+  generator.fill(v.data(), v.size(), 1e9, 1e9 + 1.);
+  {
+    ofstream ofs(path, ios::binary);
+    ofs.write(reinterpret_cast<const char*>(v.data()), N*sizeof(double));
+  }
+
+  // Reference in long double
+  long double sum = 0, sq = 0;
+  for(double x : v)
+    sum += x;
+  long double mean = sum/N;
+  for(double x : v)
+    sq += (x - mean)*(x - mean);
+  const double var = double(sq/(N - 1));
+
+  streaming::summary ref = streaming::file_stats(path, 1);
+  cout << setprecision(12) << "mean " << ref.mean << ", variance "
+       << ref.variance() << " (exact " << var << ")" << endl;
+  check("count, min, max",
+        ref.n == N && ref.min == *min_element(v.begin(), v.end()) &&
+        ref.max == *max_element(v.begin(), v.end()));
+  check("mean and variance accurate",
+        abs(ref.mean - double(mean)) < 1e-15*double(mean) &&
+        abs(ref.variance() - var) < 1e-12*var);
+
+  bool identical = true;
+  for(size_t nt : {2, 3, 8})
+    for(file_access a : {file_access::mmap, file_access::pread})
+      identical &= same(streaming::file_stats(path, nt, a), ref);
+  check("identical for any threads and access", identical);
+
+  streaming::summary mem = streaming::summarize(v.data(), N);
+  streaming::summary half1 = streaming::summarize(v.data(), N/2);
+  half1.merge(streaming::summarize(v.data() + N/2, N - N/2));
+  check("merge matches one pass",
+        half1.n == mem.n && abs(half1.mean - mem.mean) < 1e-6 &&
+        abs(half1.variance() - mem.variance()) < 1e-6*var);
+
+  {
+    string empty = path + ".empty";
+    ofstream(empty, ios::binary).close();
+    check("empty file", streaming::file_stats(empty).n == 0);
+    ofstream(empty, ios::binary).write("abc", 3);
+    bool thrown = false;
+    try {
+      streaming::file_stats(empty);
+    }
+    catch(const invalid_argument&) {
+      thrown = true;
+    }
+    check("partial double throws", thrown);
+    remove(empty.c_str());
+  }
+
+  bool thrown = false;
+  try {
+    streaming::file_stats(path + ".missing");
+  }
+  catch(const runtime_error&) {
+    thrown = true;
+  }
+  check("missing file throws", thrown);
+
+  // Throughput from the page cache, GB/s
+  string timed = argc > 1 ? argv[1] : path;
+  cout << endl << "Throughput on " << timed << " (GB/s)" << endl;
+  cout << setprecision(2) << fixed;
+  cout << setw(8) << "nt" << setw(12) << "mmap" << setw(12) << "pread"
+       << endl;
+  bench::options opt;
+  opt.min_samples = 3;
+  for(size_t nt = 1; nt <= MAX_N_THREADS; nt *= 2) {
+    cout << setw(8) << nt;
+    for(file_access a : {file_access::mmap, file_access::pread}) {
+      size_t bytes = 0;
+      double t = bench::run("", [&timed, &bytes, nt, a]() {
+        streaming::summary s = streaming::file_stats(timed, nt, a);
+        bytes = s.n*sizeof(double);
+        return s.mean;
+      }, opt).median;
+      cout << setw(12) << bytes/t/1e9;
+    }
+    cout << endl;
+  }
+
+  remove(path.c_str());
+  return check.status();
+}
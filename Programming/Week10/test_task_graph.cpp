@@ -0,0 +1,179 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Testing/timing of the dataflow task graph.
+///
+/// Pass a file name to write the trace of the pi graph in the Chrome trace
+/// event format.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "benchmark.h"
+#include "parallel_pi.h"
+#include "simd_sampling.h"
+#include "task_graph.h"
+#include "test_check.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+using namespace std;
+
+constexpr size_t N = 1 << 26;     ///< Samples of the timed pi graphs
+constexpr size_t N_TASKS = 64;    ///< Sampling tasks of the pi graphs
+constexpr size_t CHAIN = 100'000; ///< Length of the overhead chain
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Pi as a graph, sampling tasks joined by one summing continuation
+/// @param _g Graph
+/// @param _n Number of samples
+/// @return Task of the approximation
+dataflow::task<double>
+pi_graph(dataflow::graph& _g, size_t _n) {
+  vector<dataflow::task<size_t>> counts;
+  for(size_t i = 0; i < N_TASKS; ++i)
+    counts.push_back(_g.spawn("count " + to_string(i), [_n, i]() {
+      return simd::count_inner(_n/N_TASKS, 0, i);
+    }));
+  return _g.when_all("sum", counts).then("pi", [_n](const vector<size_t>& _c) {
+    return 4.*accumulate(_c.begin(), _c.end(), size_t(0))/_n;
+  });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Main driver
+/// @param _argc Number of arguments
+/// @param _argv Arguments, optionally a trace file
+/// @return Success/Failure
+int
+main(int _argc, char** _argv) {
+  checks check;
+
+  // Diamond with mixed result types, including void
+  {
+    thread_pool pool(4);
+    dataflow::graph g(pool);
+    auto a = g.spawn("a", []() { return 20; });
+    auto b = a.then("b", [](int _x) { return _x + 1; });
+    auto c = a.then("c", [](int _x) { return string(size_t(_x), 'c'); });
+    auto v = a.then("v", [](int) {});
+    auto d = g.when_all("d", b, c, v).then("e", [](const auto& _t) {
+      return get<0>(_t) + int(get<1>(_t).size());
+    });
+    auto w = v.then("w", []() { return 1; });
+    check("diamond", d.get() == 41 && w.get() == 1);
+  }
+
+  // Exceptions reach dependents, which do not run
+  {
+    thread_pool pool(2);
+    dataflow::graph g(pool);
+    bool ran = false;
+    auto a = g.spawn("a", []() -> int { throw runtime_error("a"); });
+    auto b = g.when_all("b", a, g.spawn("c", []() { return 1; }))
+              .then("d", [&ran](const auto&) { ran = true; return 0; });
+    bool thrown = false;
+    try {
+      b.get();
+    }
+    catch(const runtime_error& _e) {
+      thrown = string(_e.what()) == "a";
+    }
+    g.wait();
+    check("exception propagates", thrown && !ran);
+  }
+
+  // Deep chains and wide joins on a single worker, which blocking gets in
+  // pool tasks would deadlock
+  {
+    thread_pool pool(1);
+    dataflow::graph g(pool, false);
+    auto t = g.spawn("0", []() { return size_t(0); });
+    for(size_t i = 0; i < 1000; ++i)
+      t = t.then("+1", [](size_t _x) { return _x + 1; });
+    vector<dataflow::task<size_t>> ts(100, t);
+    auto s = g.when_all("join", ts).then("sum", [](const vector<size_t>& _v) {
+      return accumulate(_v.begin(), _v.end(), size_t(0));
+    });
+    check("no blocked workers", s.get() == 100'000);
+  }
+
+  // Critical path of a graph with known durations
+  {
+    thread_pool pool(4);
+    dataflow::graph g(pool);
+    auto sleep = [](int _ms) {
+      return [_ms]() { this_thread::sleep_for(chrono::milliseconds(_ms)); };
+    };
+    auto a = g.spawn("a", sleep(20));
+    auto b = a.then("b", sleep(60));
+    auto c = a.then("c", sleep(10));
+    auto d = g.when_all("d", b, c).then("e", [](const auto&) {
+      this_thread::sleep_for(chrono::milliseconds(20));
+    });
+    d.get();
+    g.wait();
+    dataflow::profile p = g.analyze();
+    cout << "span " << p.span << " s, work " << p.work << " s, parallelism "
+         << p.parallelism() << endl;
+    check("critical path",
+          p.critical_path ==
+            vector<size_t>{a.id(), b.id(), d.id() - 1, d.id()} &&
+          p.span >= 0.1 && p.span < 0.15);
+  }
+
+  // Timing: pi by waiting on futures against the dataflow graph
+  thread_pool pool(thread_pool::default_size());
+  cout << endl << fixed << setprecision(3);
+  auto time = [](auto _f) { return bench::run("", _f).median*1e3; };
+  cout << setw(28) << "futures get (ms)" << setw(12) << time([&pool]() {
+    return parallel::pi(N, N_TASKS, pool, sampler::simd);
+  }) << endl;
+  cout << setw(28) << "dataflow (ms)" << setw(12) << time([&pool]() {
+    dataflow::graph g(pool, false);
+    return pi_graph(g, N).get();
+  }) << endl;
+  cout << setw(28) << "dataflow traced (ms)" << setw(12) << time([&pool]() {
+    dataflow::graph g(pool);
+    return pi_graph(g, N).get();
+  }) << endl;
+
+  // Overhead per continuation
+  cout << setw(28) << "then (us/task)" << setw(12) << time([&pool]() {
+    dataflow::graph g(pool, false);
+    auto t = g.spawn("0", []() { return size_t(0); });
+    for(size_t i = 0; i < CHAIN; ++i)
+      t = t.then("+1", [](size_t _x) { return _x + 1; });
+    return t.get();
+  })*1e3/CHAIN << endl;
+
+  {
+    dataflow::graph g(pool);
+    double pi = pi_graph(g, N).get();
+    g.wait();
+    dataflow::profile p = g.analyze();
+    cout << endl << "pi " << pi << ", span " << p.span << " s, work "
+         << p.work << " s, parallelism " << p.parallelism() << endl;
+    check("pi graph", abs(pi - M_PI) < 1e-3);
+
+    ostringstream oss;
+    g.write_trace(oss);
+    oss << 0.5;
+    check("trace keeps the stream format",
+          oss.str().ends_with("]\n0.5") && oss.precision() == 6);
+    if(_argc > 1) {
+      ofstream ofs(_argv[1]);
+      g.write_trace(ofs);
+    }
+  }
+
+  return check.status();
+}
@@ -0,0 +1,156 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Bounded pool of persistent worker threads.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <latch>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "affinity.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Fixed set of worker threads pulling tasks from a shared queue.
+///
+/// Threads are created once in the constructor and joined in the destructor,
+/// so submitting work never pays for thread creation. Tasks still queued when
+/// the pool is destroyed are run before the workers exit.
+////////////////////////////////////////////////////////////////////////////////
+class thread_pool {
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors and special member functions
+    /// @{
+
+    /// @brief Construct and start the workers
+    /// @param _nt Number of worker threads, at least 1
+    /// @param _p Placement of the workers, each pins itself before running
+    ///           any task
+    ///
+    /// Returns once all workers are pinned and have recorded their thread id.
+    /// Throws std::invalid_argument without workers, as nothing would ever run
+    /// the submitted tasks.
+    explicit thread_pool(size_t _nt = default_size(),
+                         placement _p = placement::none) :
+      m_cpus(affinity::plan(affinity::detect(), _p, _nt)), m_tids(_nt),
+      m_ready(_nt) {
+      if(_nt == 0)
+        throw std::invalid_argument(
+          "Thread pool requires at least one worker.");
+      m_workers.reserve(_nt);
+      for(size_t i = 0; i < _nt; ++i)
+        m_workers.emplace_back(&thread_pool::work, this, i);
+      m_ready.wait();
+    }
+
+    /// @brief Destructor, drains the queue and joins all workers
+    ~thread_pool() {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+      }
+      m_cv.notify_all();
+      for(auto& w : m_workers)
+        w.join();
+    }
+
+    // Workers hold a pointer to the pool, so it can be neither copied nor
+    // moved.
+
+    /// @brief Copy constructor
+    thread_pool(const thread_pool&) = delete;
+    /// @brief Move constructor
+    thread_pool(thread_pool&&) = delete;
+    /// @brief Copy assignment
+    thread_pool& operator=(const thread_pool&) = delete;
+    /// @brief Move assignment
+    thread_pool& operator=(thread_pool&&) = delete;
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Number of worker threads
+    size_t size() const noexcept { return m_workers.size(); }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief CPU each worker is pinned to, -1 if unpinned
+    const std::vector<int>& cpus() const noexcept { return m_cpus; }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Kernel thread id of each worker, e.g., to attach counters
+    const std::vector<int>& tids() const noexcept { return m_tids; }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Default pool size, one worker per hardware thread
+    static size_t default_size() noexcept {
+      size_t nt = std::thread::hardware_concurrency();
+      return nt == 0 ? 1 : nt;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Queue a task for execution on the pool.
+    /// @tparam F Callable type
+    /// @tparam Args Argument types
+    /// @param _f Callable
+    /// @param _args Arguments, copied into the task
+    /// @return Future holding the result of @c _f
+    template<typename F, typename... Args>
+    auto submit(F&& _f, Args&&... _args)
+      -> std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> {
+      using R = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+
+      // std::function must be copyable, packaged_task is not, so share it.
+      auto task = std::make_shared<std::packaged_task<R()>>(
+        std::bind(std::forward<F>(_f), std::forward<Args>(_args)...)
+      );
+      std::future<R> ft = task->get_future();
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.emplace([task]() { (*task)(); });
+      }
+      m_cv.notify_one();
+      return ft;
+    }
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Worker loop, run tasks until stopped and the queue is empty
+    /// @param _i Worker index
+    void work(size_t _i) {
+      affinity::pin(m_cpus[_i]);
+      m_tids[_i] = affinity::thread_id();
+      m_ready.count_down();
+      while(true) {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(m_mutex);
+          m_cv.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+          if(m_tasks.empty())
+            return;
+          task = std::move(m_tasks.front());
+          m_tasks.pop();
+        }
+        task();
+      }
+    }
+
+    std::vector<int> m_cpus;                   ///< Planned CPU per worker
+    std::vector<int> m_tids;                   ///< Thread id per worker
+    std::latch m_ready;                        ///< Workers not set up yet
+    std::vector<std::thread> m_workers;        ///< Worker threads
+    std::queue<std::function<void()>> m_tasks; ///< Pending tasks
+    std::mutex m_mutex;                        ///< Guards tasks and stop flag
+    std::condition_variable m_cv;              ///< Signals new tasks/stop
+    bool m_stop{false};                        ///< Pool is shutting down
+};
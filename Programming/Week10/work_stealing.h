@@ -0,0 +1,290 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Work-stealing executor for fine-grained chunked parallel loops.
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "affinity.h"
+#include "thread_pool.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Pool of workers that each own a deque of chunk tasks.
+///
+/// A parallel loop is cut into many small chunks that are dealt out in
+/// contiguous runs to the workers' deques. A worker pops its own deque from the
+/// back and, once empty, steals from the front of a randomly chosen victim, so
+/// a preempted or slow worker only holds up the chunks it is running instead of
+/// a whole static slab.
+////////////////////////////////////////////////////////////////////////////////
+class work_stealing_pool {
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Per-worker counters
+    ////////////////////////////////////////////////////////////////////////////
+    struct worker_stats {
+      size_t executed{0};                        ///< Chunks run
+      size_t steals{0};                          ///< Chunks stolen
+      std::chrono::duration<double> idle{0.};    ///< Time without work
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors and special member functions
+    /// @{
+
+    /// @brief Construct and start the workers
+    /// @param _nt Number of worker threads, at least 1
+    /// @param _p Placement of the workers
+    ///
+    /// Each worker pins itself and then allocates its own deque and counters,
+    /// so with a placement they live on the worker's NUMA node. The
+    /// constructor returns once all workers exist. Throws
+    /// std::invalid_argument without workers, as parallel_for would deal its
+    /// chunks to no one and wait forever.
+    explicit work_stealing_pool(size_t _nt = thread_pool::default_size(),
+                                placement _p = placement::none) :
+      m_workers(_nt), m_cpus(affinity::plan(affinity::detect(), _p, _nt)),
+      m_tids(_nt), m_ready(_nt) {
+      if(_nt == 0)
+        throw std::invalid_argument(
+          "Work-stealing pool requires at least one worker.");
+      m_threads.reserve(_nt);
+      for(size_t i = 0; i < _nt; ++i)
+        m_threads.emplace_back(&work_stealing_pool::work, this, i);
+      m_ready.wait();
+    }
+
+    /// @brief Destructor, joins all workers
+    ~work_stealing_pool() {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+      }
+      m_cv.notify_all();
+      for(auto& t : m_threads)
+        t.join();
+    }
+
+    /// @brief Copy constructor
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    /// @brief Move constructor
+    work_stealing_pool(work_stealing_pool&&) = delete;
+    /// @brief Copy assignment
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+    /// @brief Move assignment
+    work_stealing_pool& operator=(work_stealing_pool&&) = delete;
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Number of worker threads
+    size_t size() const noexcept { return m_workers.size(); }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief CPU each worker is pinned to, -1 if unpinned
+    const std::vector<int>& cpus() const noexcept { return m_cpus; }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Kernel thread id of each worker, e.g., to attach counters
+    const std::vector<int>& tids() const noexcept { return m_tids; }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Run chunks 0.._n_chunks-1 in parallel and wait for all of them
+    /// @tparam F Callable taking (chunk index, worker index)
+    /// @param _n_chunks Number of chunks
+    /// @param _f Callable
+    ///
+    /// The worker index lets @c _f keep per-worker partial results without
+    /// synchronization.
+    ///
+    /// Must not be called from inside @c _f or any other task of this pool:
+    /// the calling worker blocks until the nested chunks finish, and once all
+    /// workers block that way nothing is left to run them, so it deadlocks.
+    template<typename F>
+    void parallel_for(size_t _n_chunks, F&& _f) {
+      if(_n_chunks == 0)
+        return;
+
+      job j;
+      j.f = std::forward<F>(_f);
+      j.remaining = _n_chunks;
+
+      // Count the chunks as pending before they become visible, so a busy
+      // worker taking one early never drives the count below zero.
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending += _n_chunks;
+      }
+
+      // Deal out contiguous runs of chunks, one per worker
+      const size_t nt = size();
+      for(size_t w = 0; w < nt; ++w) {
+        size_t begin = w*_n_chunks/nt, end = (w + 1)*_n_chunks/nt;
+        std::lock_guard<std::mutex> lock(m_workers[w]->mutex);
+        for(size_t c = begin; c < end; ++c)
+          m_workers[w]->tasks.push_back({&j, c});
+      }
+      m_cv.notify_all();
+
+      std::unique_lock<std::mutex> lock(j.mutex);
+      j.cv.wait(lock, [&j]() { return j.remaining == 0; });
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Snapshot of the per-worker counters
+    std::vector<worker_stats> stats() const {
+      std::vector<worker_stats> s(size());
+      for(size_t w = 0; w < size(); ++w) {
+        s[w].executed = m_workers[w]->executed;
+        s[w].steals = m_workers[w]->steals;
+        s[w].idle = std::chrono::duration<double>(m_workers[w]->idle_ns*1e-9);
+      }
+      return s;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Reset the per-worker counters
+    void reset_stats() {
+      for(auto& w : m_workers) {
+        w->executed = 0;
+        w->steals = 0;
+        w->idle_ns = 0;
+      }
+    }
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief One parallel_for call
+    ////////////////////////////////////////////////////////////////////////////
+    struct job {
+      std::function<void(size_t, size_t)> f; ///< Chunk function
+      size_t remaining{0};                   ///< Chunks not finished
+      std::mutex mutex;                      ///< Guards remaining
+      std::condition_variable cv;            ///< Signals completion
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief One chunk of a job
+    ////////////////////////////////////////////////////////////////////////////
+    struct task {
+      job* j;       ///< Owning job
+      size_t chunk; ///< Chunk index
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Deque and counters of one worker, on their own cache lines
+    ////////////////////////////////////////////////////////////////////////////
+    struct alignas(64) worker {
+      std::mutex mutex;                 ///< Guards tasks
+      std::deque<task> tasks;           ///< Owner pops back, thieves front
+      std::atomic<size_t> executed{0};  ///< Chunks run
+      std::atomic<size_t> steals{0};    ///< Chunks stolen
+      std::atomic<uint64_t> idle_ns{0}; ///< Time without work
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Take a task, own deque first, then steal
+    /// @param _w Worker index
+    /// @param _rng Worker's state for choosing victims
+    /// @param _t Output task
+    /// @return True if a task was found
+    bool take(size_t _w, uint64_t& _rng, task& _t) {
+      {
+        worker& me = *m_workers[_w];
+        std::lock_guard<std::mutex> lock(me.mutex);
+        if(!me.tasks.empty()) {
+          _t = me.tasks.back();
+          me.tasks.pop_back();
+          return true;
+        }
+      }
+
+      // Visit all other workers starting at a random victim
+      const size_t nt = size();
+      _rng ^= _rng << 13;
+      _rng ^= _rng >> 7;
+      _rng ^= _rng << 17;
+      for(size_t k = 0; k + 1 < nt; ++k) {
+        size_t v = (_w + 1 + (_rng + k) % (nt - 1)) % nt;
+        worker& victim = *m_workers[v];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(!victim.tasks.empty()) {
+          _t = victim.tasks.front();
+          victim.tasks.pop_front();
+          ++m_workers[_w]->steals;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Worker loop
+    /// @param _w Worker index
+    void work(size_t _w) {
+      affinity::pin(m_cpus[_w]);
+      m_workers[_w] = std::make_unique<worker>();
+      m_tids[_w] = affinity::thread_id();
+      m_ready.arrive_and_wait();
+
+      using my_clock = std::chrono::steady_clock;
+      uint64_t rng = 0x9E3779B97F4A7C15ull*(_w + 1);
+      my_clock::time_point idle_since = my_clock::now();
+      bool idle = true;
+
+      while(true) {
+        task t;
+        if(take(_w, rng, t)) {
+          if(idle) {
+            m_workers[_w]->idle_ns += std::chrono::duration_cast<
+              std::chrono::nanoseconds>(my_clock::now() - idle_since).count();
+            idle = false;
+          }
+          {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_pending;
+          }
+          t.j->f(t.chunk, _w);
+          ++m_workers[_w]->executed;
+
+          std::lock_guard<std::mutex> lock(t.j->mutex);
+          if(--t.j->remaining == 0)
+            t.j->cv.notify_all();
+          continue;
+        }
+
+        if(!idle) {
+          idle_since = my_clock::now();
+          idle = true;
+        }
+        // Sleep until tasks are queued. Idle time between jobs counts as idle.
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this]() { return m_stop || m_pending > 0; });
+        if(m_stop)
+          return;
+      }
+    }
+
+    std::vector<std::unique_ptr<worker>> m_workers; ///< Per-worker state
+    std::vector<int> m_cpus;                        ///< Planned CPU per worker
+    std::vector<int> m_tids;                        ///< Thread id per worker
+    std::latch m_ready;                             ///< Workers not set up yet
+    std::vector<std::thread> m_threads;             ///< Worker threads
+    std::mutex m_mutex;                             ///< Guards pending, stop
+    std::condition_variable m_cv;                   ///< Signals new tasks/stop
+    size_t m_pending{0};                            ///< Queued, not taken tasks
+    bool m_stop{false};                             ///< Pool is shutting down
+};